@@ -0,0 +1,509 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "Model.h"
+#include "Camera.h"
+#include "MaterialLibrary.h"
+#include "ResolutionScaler.h"
+#include "RingBuffer.h"
+#include "SceneRenderer.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "Benchmark.h"
+
+#ifndef OPENGLTEST_RES_DIR
+#define OPENGLTEST_RES_DIR "res"
+#endif
+#ifndef OPENGLTEST_BUILD_TYPE
+#define OPENGLTEST_BUILD_TYPE "unknown"
+#endif
+#ifndef OPENGLTEST_BENCH_SCENE_DIR
+#define OPENGLTEST_BENCH_SCENE_DIR "."
+#endif
+
+// Benchmark scene, written to the build directory so an interrupted run can't leave files in the source tree.
+// Removed again on exit
+const int sceneMeshCount = 64;
+const int sceneGridSize = 48;      // Quads per side of every mesh, 2 * 48 * 48 triangles each
+const int sceneMaterialCount = 8;
+const int sceneTextureCount = 2;   // Copies of res/model/ao.jpg
+const std::string sceneDir = OPENGLTEST_BENCH_SCENE_DIR;
+const std::string scenePath = sceneDir + "/bench_scene.obj";
+const std::string sceneMaterialPath = sceneDir + "/bench_scene.mtl";
+
+bool ReadFile(const std::string& path, std::vector<unsigned char>& bytes)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+std::string SceneTextureName(int index) // Relative to sceneDir
+{
+	return "bench_scene_tex" + std::to_string(index) + ".jpg";
+}
+
+// A grid of sphere patches spread over materials and textures, so import, draw and BVH work all scale like a real model
+bool WriteBenchScene(const std::vector<unsigned char>& texture)
+{
+	for (int i = 0; i < sceneTextureCount; i++)
+	{
+		std::ofstream file(sceneDir + "/" + SceneTextureName(i), std::ios::binary);
+		file.write(reinterpret_cast<const char*>(texture.data()), texture.size());
+	}
+
+	std::ofstream mtl(sceneMaterialPath);
+	for (int i = 0; i < sceneMaterialCount; i++)
+	{
+		mtl << "newmtl material" << i << "\nmap_Kd " << SceneTextureName(i % sceneTextureCount) << "\n";
+		if (i % 2)
+			mtl << "map_Ks " << SceneTextureName((i + 1) % sceneTextureCount) << "\n";
+	}
+
+	std::ofstream obj(scenePath);
+	if (!obj)
+		return false;
+	obj << "mtllib bench_scene.mtl\n";
+	const float pi = 3.14159265f;
+	int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(sceneMeshCount))));
+	int base = 1;
+	for (int mesh = 0; mesh < sceneMeshCount; mesh++)
+	{
+		obj << "o mesh" << mesh << "\nusemtl material" << mesh % sceneMaterialCount << "\n";
+		glm::vec3 center(static_cast<float>(mesh % side) * 2.5f, 0.0f, static_cast<float>(mesh / side) * 2.5f);
+		for (int y = 0; y <= sceneGridSize; y++)
+		{
+			for (int x = 0; x <= sceneGridSize; x++)
+			{
+				float u = static_cast<float>(x) / sceneGridSize, v = static_cast<float>(y) / sceneGridSize;
+				float theta = u * 2.0f * pi, phi = v * pi;
+				glm::vec3 normal(std::cos(theta) * std::sin(phi), std::cos(phi), std::sin(theta) * std::sin(phi));
+				glm::vec3 position = center + normal;
+				obj << "v " << position.x << " " << position.y << " " << position.z << "\n";
+				obj << "vt " << u << " " << v << "\n";
+				obj << "vn " << normal.x << " " << normal.y << " " << normal.z << "\n";
+			}
+		}
+		for (int y = 0; y < sceneGridSize; y++)
+		{
+			for (int x = 0; x < sceneGridSize; x++)
+			{
+				int a = base + y * (sceneGridSize + 1) + x, b = a + 1, c = a + sceneGridSize + 1, d = c + 1;
+				obj << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c << " " << b << "/" << b << "/" << b << "\n";
+				obj << "f " << b << "/" << b << "/" << b << " " << c << "/" << c << "/" << c << " " << d << "/" << d << "/" << d << "\n";
+			}
+		}
+		base += (sceneGridSize + 1) * (sceneGridSize + 1);
+	}
+	return static_cast<bool>(obj);
+}
+void RemoveBenchScene()
+{
+	std::remove(scenePath.c_str());
+	std::remove(sceneMaterialPath.c_str());
+	for (int i = 0; i < sceneTextureCount; i++)
+		std::remove((sceneDir + "/" + SceneTextureName(i)).c_str());
+}
+
+std::vector<Ray> RandomRays(const AABB& bounds, unsigned int count, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	glm::vec3 center = (bounds.Min + bounds.Max) * 0.5f, extent = bounds.Max - bounds.Min;
+	std::vector<Ray> rays(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		// From a point above the scene towards a random point inside it, like picking from the camera
+		glm::vec3 target = bounds.Min + glm::vec3(unit(rng) * extent.x, unit(rng) * extent.y, unit(rng) * extent.z);
+		rays[i].Origin = center + glm::vec3(0.0f, extent.y + 5.0f, extent.z);
+		rays[i].Direction = glm::normalize(target - rays[i].Origin);
+	}
+	return rays;
+}
+
+// Primary rays of a camera above the scene, ordered so every four rays are one 2x2 pixel block
+std::vector<Ray> PixelBlockRays(const AABB& bounds, int width, int height)
+{
+	glm::vec3 center = (bounds.Min + bounds.Max) * 0.5f, extent = bounds.Max - bounds.Min;
+	glm::vec3 origin = center + glm::vec3(0.0f, extent.y + 5.0f, extent.z);
+	glm::vec3 front = glm::normalize(center - origin);
+	glm::vec3 right = glm::normalize(glm::cross(front, glm::vec3(0.0f, 1.0f, 0.0f)));
+	glm::vec3 up = glm::cross(right, front);
+	float tanHalfFov = std::tan(glm::radians(45.0f) * 0.5f), aspect = static_cast<float>(width) / height;
+
+	std::vector<Ray> rays;
+	rays.reserve(static_cast<size_t>(width) * height);
+	for (int blockY = 0; blockY < height; blockY += 2)
+	{
+		for (int blockX = 0; blockX < width; blockX += 2)
+		{
+			for (int pixel = 0; pixel < 4; pixel++)
+			{
+				float ndcX = 2.0f * (blockX + (pixel & 1) + 0.5f) / width - 1.0f;
+				float ndcY = 1.0f - 2.0f * (blockY + (pixel >> 1) + 0.5f) / height;
+				Ray ray;
+				ray.Origin = origin;
+				ray.Direction = glm::normalize(front + right * (ndcX * tanHalfFov * aspect) + up * (ndcY * tanHalfFov));
+				rays.push_back(ray);
+			}
+		}
+	}
+	return rays;
+}
+
+// Packet traversal must agree with single rays. Every mesh is added three times, scaled about its centre, so the
+// copies share a centroid and end up in one TLAS leaf where the outer copy hides the inner ones
+bool CheckPacketTraversal(const Model& model, const std::vector<Ray>& rays)
+{
+	TopLevelBVH tlas;
+	const float scales[] = { 1.1f, 1.0f, 0.9f };
+	for (unsigned int i = 0; i < model.meshes.size(); i++)
+	{
+		const BVH& bvh = model.meshes[i].bvh;
+		AABB bounds = bvh.GetBounds();
+		glm::vec3 center = (bounds.Min + bounds.Max) * 0.5f;
+		for (float scale : scales)
+		{
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), center);
+			transform = glm::scale(transform, glm::vec3(scale));
+			transform = glm::translate(transform, -center);
+			tlas.AddInstance(bvh, transform);
+		}
+	}
+	tlas.Build();
+
+	unsigned int mismatches = 0;
+	for (size_t r = 0; r + 4 <= rays.size(); r += 4)
+	{
+		RayPacket4 packet;
+		RayHit4 hits;
+		for (int lane = 0; lane < 4; lane++)
+			packet.Set(lane, rays[r + lane]);
+		tlas.Intersect4(packet, hits);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			RayHit hit;
+			tlas.Intersect(rays[r + lane], hit);
+			const RayHit& packetHit = hits.Hits[lane];
+			// Triangles may differ on shared edges, the distance and instance may not
+			if (hit.Hit() != packetHit.Hit() || (hit.Hit() && (hit.Instance != packetHit.Instance || std::abs(hit.t - packetHit.t) > 1e-4f * hit.t)))
+				mismatches++;
+		}
+	}
+	if (mismatches > 0)
+		std::cout << "Error: packet traversal disagrees with single rays for " << mismatches << " of " << rays.size() << " rays" << std::endl;
+	return mismatches == 0;
+}
+
+void PrintUsage()
+{
+	std::cout << "Usage: engine_bench [--filter <substring>] [--min-time <seconds>] [--out <file.json>]\n"
+		"                    [--baseline <file.json>] [--max-regression <fraction>] [--res <res dir>]\n";
+}
+
+int main(int argc, char** argv)
+{
+	std::string filter, outPath, baselinePath, resDir = OPENGLTEST_RES_DIR;
+	double minTime = 0.5, maxRegression = -1.0;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--filter" && hasValue)
+			filter = argv[++i];
+		else if (arg == "--min-time" && hasValue)
+			minTime = std::atof(argv[++i]);
+		else if (arg == "--out" && hasValue)
+			outPath = argv[++i];
+		else if (arg == "--baseline" && hasValue)
+			baselinePath = argv[++i];
+		else if (arg == "--max-regression" && hasValue)
+			maxRegression = std::atof(argv[++i]);
+		else if (arg == "--res" && hasValue)
+			resDir = argv[++i];
+		else
+		{
+			PrintUsage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	BenchmarkRunner runner(minTime, filter);
+	if (!baselinePath.empty() && !runner.LoadBaseline(baselinePath))
+	{
+		std::cout << "Error: can't read baseline " << baselinePath << std::endl;
+		return 1;
+	}
+
+	std::vector<unsigned char> jpeg;
+	if (!ReadFile(resDir + "/model/ao.jpg", jpeg) || !WriteBenchScene(jpeg))
+	{
+		std::cout << "Error: can't build the benchmark scene in " << sceneDir << " from " << resDir << "/model/ao.jpg" << std::endl;
+		RemoveBenchScene();
+		return 1;
+	}
+	std::string vertexPath = resDir + "/shader/vertex.glsl";
+
+	// Import
+	runner.Run("model_import", 1.0, [&](uint64_t n)
+		{
+			for (uint64_t i = 0; i < n; i++)
+			{
+				Model model(scenePath);
+				DoNotOptimize(&model);
+			}
+		});
+	{
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(scenePath, modelImportFlags);
+		if (!scene)
+		{
+			std::cout << "Error: Assimp failed to import the benchmark scene: " << importer.GetErrorString() << std::endl;
+			RemoveBenchScene();
+			return 1;
+		}
+		unsigned int vertexCount = 0;
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+			vertexCount += scene->mMeshes[i]->mNumVertices;
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		runner.Run("process_mesh_vertices", vertexCount, [&](uint64_t n)
+			{
+				for (uint64_t i = 0; i < n; i++)
+				{
+					for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+					{
+						vertices.clear();
+						indices.clear();
+						ConvertMesh(scene->mMeshes[m], vertices, indices);
+						DoNotOptimize(vertices.data());
+					}
+				}
+			});
+	}
+	{
+		// Items are decoded pixels, so the rate stays comparable whatever size ao.jpg is
+		int width = 0, height = 0, components = 0;
+		unsigned char* pixels = stbi_load_from_memory(jpeg.data(), static_cast<int>(jpeg.size()), &width, &height, &components, 0);
+		if (pixels)
+		{
+			stbi_image_free(pixels);
+			runner.Run("texture_decode_ao_jpg", static_cast<double>(width) * height, [&](uint64_t n)
+				{
+					for (uint64_t i = 0; i < n; i++)
+					{
+						int w, h, channels;
+						unsigned char* decoded = stbi_load_from_memory(jpeg.data(), static_cast<int>(jpeg.size()), &w, &h, &channels, 0);
+						DoNotOptimize(decoded);
+						stbi_image_free(decoded);
+					}
+				});
+		}
+		else
+			std::cout << "Warning: stb_image can't decode " << resDir << "/model/ao.jpg, skipping texture_decode_ao_jpg" << std::endl;
+	}
+
+	// Per-frame CPU paths
+	Shader shader(vertexPath.c_str(), (resDir + "/shader/fragment.glsl").c_str());
+	const char* uniformNames[] = { "model", "view", "projection", "texture_diffuse1", "texture_specular1", "texture_normal1", "texture_height1", "materialIndex" };
+	runner.Run("shader_uniform_lookup", 8.0, [&](uint64_t n)
+		{
+			for (uint64_t i = 0; i < n; i++)
+				for (int u = 0; u < 8; u++)
+					shader.SetUniform1i(uniformNames[u], u);
+		});
+
+	Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+	runner.Run("camera_update", 1.0, [&](uint64_t n)
+		{
+			for (uint64_t i = 0; i < n; i++)
+			{
+				camera.ProcessMouseMovement(0.5f, (i & 1) ? 0.25f : -0.25f);
+				glm::mat4 view = camera.GetViewMatrix();
+				glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), 16.0f / 9.0f, 0.1f, 100.0f);
+				glm::mat4 viewProjection = projection * view;
+				DoNotOptimize(&viewProjection);
+			}
+		});
+
+	Model model(scenePath);
+	if (model.meshes.empty())
+	{
+		RemoveBenchScene();
+		return 1;
+	}
+	TopLevelBVH sceneBVH;
+	for (unsigned int i = 0; i < model.meshes.size(); i++)
+		sceneBVH.AddInstance(model.meshes[i].bvh);
+	sceneBVH.Build();
+	{
+		// The same per-frame submission App::Run does, at 1080p
+		SceneRenderer renderer(model, sceneBVH, resDir + "/shader", 1920, 1080);
+		shader.SetUniformBlockBinding("PerFrame", perFrameBinding);
+		runner.Run("render_frame_model_draw", static_cast<double>(model.meshes.size()), [&](uint64_t n)
+			{
+				for (uint64_t i = 0; i < n; i++)
+					renderer.Render(camera, shader, nullptr, 1920, 1080, false);
+			});
+		Shader materialShader(vertexPath.c_str(), (resDir + "/shader/material_fragment.glsl").c_str());
+		materialShader.SetUniformBlockBinding("PerFrame", perFrameBinding);
+		MaterialLibrary materials(model, false);
+		materials.SetupShader(materialShader, materialsBinding);
+		runner.Run("render_frame_material_library", static_cast<double>(model.meshes.size()), [&](uint64_t n)
+			{
+				for (uint64_t i = 0; i < n; i++)
+					renderer.Render(camera, materialShader, &materials, 1920, 1080, false);
+			});
+	}
+	{
+		ResolutionScaler scaler;
+		runner.Run("resolution_scaler_frame", 1.0, [&](uint64_t n)
+			{
+				for (uint64_t i = 0; i < n; i++)
+				{
+					scaler.BeginFrame();
+					scaler.EndFrame();
+					int width = scaler.ScaledSize(1920);
+					DoNotOptimize(&width);
+				}
+			});
+	}
+	RingBuffer ring(GL_UNIFORM_BUFFER, 64 * 1024);
+	runner.Run("ring_buffer_allocate_unsynchronized", 64.0, [&](uint64_t n)
+		{
+			glm::mat4 data(1.0f);
+			for (uint64_t i = 0; i < n; i++)
+			{
+				ring.BeginFrame();
+				for (int a = 0; a < 64; a++)
+					ring.Allocate(data);
+				ring.EndFrame();
+			}
+		});
+	{
+		g_MockGLEW_ARB_buffer_storage = GL_TRUE;
+		RingBuffer persistentRing(GL_UNIFORM_BUFFER, 64 * 1024);
+		g_MockGLEW_ARB_buffer_storage = GL_FALSE;
+		runner.Run("ring_buffer_allocate_persistent", 64.0, [&](uint64_t n)
+			{
+				glm::mat4 data(1.0f);
+				for (uint64_t i = 0; i < n; i++)
+				{
+					persistentRing.BeginFrame();
+					for (int a = 0; a < 64; a++)
+						persistentRing.Allocate(data);
+					persistentRing.EndFrame();
+				}
+			});
+	}
+
+	// Ray queries
+	Mesh& firstMesh = model.meshes[0];
+	runner.Run("bvh_build_mesh", firstMesh.indices.size() / 3.0, [&](uint64_t n)
+		{
+			for (uint64_t i = 0; i < n; i++)
+			{
+				BVH bvh;
+				bvh.Build(firstMesh.vertices, firstMesh.indices);
+				DoNotOptimize(&bvh);
+			}
+		});
+	runner.Run("tlas_refit", static_cast<double>(sceneBVH.GetInstanceCount()), [&](uint64_t n)
+		{
+			for (uint64_t i = 0; i < n; i++)
+			{
+				for (unsigned int m = 0; m < sceneBVH.GetInstanceCount(); m++)
+					sceneBVH.SetTransform(m, glm::mat4(1.0f));
+				sceneBVH.Refit();
+			}
+		});
+
+	AABB sceneBounds;
+	for (unsigned int i = 0; i < model.meshes.size(); i++)
+		sceneBounds.Grow(model.meshes[i].bvh.GetBounds());
+	std::vector<Ray> rays = RandomRays(sceneBounds, 4096, 1);
+	if (!CheckPacketTraversal(model, rays))
+	{
+		RemoveBenchScene();
+		return 1;
+	}
+	// Random rays are the worst case for packets, 2x2 pixel blocks of a camera view are what they're for
+	std::vector<Ray> pixelRays = PixelBlockRays(sceneBounds, 64, 64);
+	if (!CheckPacketTraversal(model, pixelRays))
+	{
+		RemoveBenchScene();
+		return 1;
+	}
+	auto runRays = [&](const std::string& name, const std::vector<Ray>& benchRays)
+	{
+		runner.Run(name + "_single", static_cast<double>(benchRays.size()), [&](uint64_t n)
+			{
+				for (uint64_t i = 0; i < n; i++)
+				{
+					for (size_t r = 0; r < benchRays.size(); r++)
+					{
+						RayHit hit;
+						sceneBVH.Intersect(benchRays[r], hit);
+						DoNotOptimize(&hit);
+					}
+				}
+			});
+		runner.Run(name + "_packet4", static_cast<double>(benchRays.size()), [&](uint64_t n)
+			{
+				for (uint64_t i = 0; i < n; i++)
+				{
+					for (size_t r = 0; r + 4 <= benchRays.size(); r += 4)
+					{
+						RayPacket4 packet;
+						RayHit4 hits;
+						for (int lane = 0; lane < 4; lane++)
+							packet.Set(lane, benchRays[r + lane]);
+						sceneBVH.Intersect4(packet, hits);
+						DoNotOptimize(&hits);
+					}
+				}
+			});
+	};
+	runRays("tlas_ray", rays);
+	runRays("tlas_ray_coherent", pixelRays);
+
+	RemoveBenchScene();
+
+	std::stringstream context;
+	context << "{ \"compiler\": \"" <<
+#if defined(__clang__)
+		"clang " << __clang_major__ << "." << __clang_minor__
+#elif defined(__GNUC__)
+		"gcc " << __GNUC__ << "." << __GNUC_MINOR__
+#elif defined(_MSC_VER)
+		"msvc " << _MSC_VER
+#else
+		"unknown"
+#endif
+		<< "\", \"build_type\": \"" << OPENGLTEST_BUILD_TYPE << "\", \"mesh_count\": " << model.meshes.size()
+		<< ", \"min_time\": " << minTime << " }";
+	if (!outPath.empty() && !runner.WriteJson(outPath, context.str()))
+	{
+		std::cout << "Error: can't write " << outPath << std::endl;
+		return 1;
+	}
+	if (maxRegression >= 0.0)
+	{
+		int regressions = runner.CountRegressions(maxRegression);
+		if (regressions > 0)
+		{
+			std::cout << regressions << " benchmark(s) regressed by more than " << maxRegression * 100.0 << "%" << std::endl;
+			return 2;
+		}
+	}
+	return 0;
+}
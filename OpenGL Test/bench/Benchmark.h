@@ -0,0 +1,180 @@
+#pragma once
+#include <GL/glew.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Filled in by the replacement operator new in CountingAllocator.cpp
+struct AllocationCounters
+{
+	std::atomic<uint64_t> Allocations{ 0 };
+	std::atomic<uint64_t> Bytes{ 0 };
+};
+extern AllocationCounters g_Allocations;
+
+// Keeps the compiler from dropping a result the benchmark never reads. Storing the pointer alone isn't enough,
+// the compiler must also assume the memory behind it is read
+inline void DoNotOptimize(const void* value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r"(value) : "memory");
+#else
+	static const void* volatile sink;
+	sink = value;
+	(void)sink;
+	_ReadWriteBarrier();
+#endif
+}
+
+struct BenchmarkResult
+{
+	std::string Name;
+	uint64_t Iterations = 0;
+	double NsPerIter = 0.0;
+	double ItemsPerSecond = 0.0;
+	double AllocsPerIter = 0.0;
+	double BytesPerIter = 0.0;
+	double GLCallsPerIter = 0.0;
+	double TextureBindsPerIter = 0.0;
+	double BaselineNsPerIter = 0.0; // 0 when the baseline has no entry
+};
+
+// Runs each body in batches until it has taken minTime, then reports the median of several batches.
+// A body receives the number of iterations to run so per-call overhead stays out of the timing
+class BenchmarkRunner
+{
+public:
+	BenchmarkRunner(double minTime, const std::string& filter)
+		: m_MinTime(minTime), m_Filter(filter)
+	{
+	}
+
+	bool Enabled(const std::string& name) const
+	{
+		return m_Filter.empty() || name.find(m_Filter) != std::string::npos;
+	}
+	void Run(const std::string& name, double itemsPerIter, const std::function<void(uint64_t)>& body)
+	{
+		if (!Enabled(name))
+			return;
+
+		// Grow the batch until one batch takes a fifth of the time budget
+		uint64_t iterations = 1;
+		while (true)
+		{
+			double elapsed = Time(body, iterations);
+			if (elapsed >= m_MinTime / sampleCount || iterations >= (1ull << 40))
+				break;
+			uint64_t scale = elapsed > 0.0 ? static_cast<uint64_t>(m_MinTime / sampleCount / elapsed * 1.2) : 10;
+			iterations *= std::min<uint64_t>(std::max<uint64_t>(scale, 2), 10);
+		}
+
+		uint64_t allocations = g_Allocations.Allocations, bytes = g_Allocations.Bytes;
+		uint64_t calls = g_MockGL.Calls, textureBinds = g_MockGL.TextureBinds;
+		std::vector<double> samples;
+		for (int i = 0; i < sampleCount; i++)
+			samples.push_back(Time(body, iterations));
+		double total = static_cast<double>(iterations) * sampleCount;
+
+		std::sort(samples.begin(), samples.end());
+		BenchmarkResult result;
+		result.Name = name;
+		result.Iterations = iterations;
+		result.NsPerIter = samples[sampleCount / 2] * 1e9 / iterations;
+		result.ItemsPerSecond = itemsPerIter * 1e9 / result.NsPerIter;
+		result.AllocsPerIter = (g_Allocations.Allocations - allocations) / total;
+		result.BytesPerIter = (g_Allocations.Bytes - bytes) / total;
+		result.GLCallsPerIter = (g_MockGL.Calls - calls) / total;
+		result.TextureBindsPerIter = (g_MockGL.TextureBinds - textureBinds) / total;
+		auto baseline = m_Baseline.find(name);
+		if (baseline != m_Baseline.end())
+			result.BaselineNsPerIter = baseline->second;
+		Print(result);
+		m_Results.push_back(result);
+	}
+
+	bool LoadBaseline(const std::string& path)
+	{
+		std::ifstream file(path);
+		if (!file)
+			return false;
+		// WriteJson puts one benchmark per line, which is all this needs to understand
+		std::regex entry("\"name\": \"([^\"]+)\".*\"ns_per_iter\": ([0-9.eE+-]+)");
+		std::string line;
+		std::smatch match;
+		while (std::getline(file, line))
+			if (std::regex_search(line, match, entry))
+				m_Baseline[match[1]] = std::stod(match[2]);
+		return true;
+	}
+	bool WriteJson(const std::string& path, const std::string& context) const
+	{
+		std::ofstream file(path);
+		if (!file)
+			return false;
+		file << "{\n  \"context\": " << context << ",\n  \"benchmarks\": [\n";
+		for (size_t i = 0; i < m_Results.size(); i++)
+		{
+			const BenchmarkResult& r = m_Results[i];
+			file << "    { \"name\": \"" << r.Name << "\", \"iterations\": " << r.Iterations
+				<< ", \"ns_per_iter\": " << r.NsPerIter << ", \"items_per_second\": " << r.ItemsPerSecond
+				<< ", \"allocs_per_iter\": " << r.AllocsPerIter << ", \"bytes_per_iter\": " << r.BytesPerIter
+				<< ", \"gl_calls_per_iter\": " << r.GLCallsPerIter << ", \"texture_binds_per_iter\": " << r.TextureBindsPerIter;
+			if (r.BaselineNsPerIter > 0.0)
+				file << ", \"baseline_ns_per_iter\": " << r.BaselineNsPerIter << ", \"ratio\": " << r.NsPerIter / r.BaselineNsPerIter;
+			file << " }" << (i + 1 < m_Results.size() ? "," : "") << "\n";
+		}
+		file << "  ]\n}\n";
+		return true;
+	}
+	// Benchmarks that got slower than the baseline by more than threshold (0.1 = 10%)
+	int CountRegressions(double threshold) const
+	{
+		int count = 0;
+		for (size_t i = 0; i < m_Results.size(); i++)
+			if (m_Results[i].BaselineNsPerIter > 0.0 && m_Results[i].NsPerIter > m_Results[i].BaselineNsPerIter * (1.0 + threshold))
+				count++;
+		return count;
+	}
+
+private:
+	static const int sampleCount = 5;
+	double m_MinTime;
+	std::string m_Filter;
+	std::map<std::string, double> m_Baseline;
+	std::vector<BenchmarkResult> m_Results;
+
+	static double Time(const std::function<void(uint64_t)>& body, uint64_t iterations)
+	{
+		auto start = std::chrono::steady_clock::now();
+		body(iterations);
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	static void Print(const BenchmarkResult& r)
+	{
+		char line[256];
+		std::snprintf(line, sizeof(line), "%-32s %14.1f ns/iter %12.3g items/s %8.1f allocs %8.1f gl calls", r.Name.c_str(),
+			r.NsPerIter, r.ItemsPerSecond, r.AllocsPerIter, r.GLCallsPerIter);
+		std::cout << line;
+		if (r.BaselineNsPerIter > 0.0)
+		{
+			std::snprintf(line, sizeof(line), "  %+6.1f%% vs baseline", (r.NsPerIter / r.BaselineNsPerIter - 1.0) * 100.0);
+			std::cout << line;
+		}
+		std::cout << std::endl;
+	}
+};
@@ -0,0 +1,59 @@
+#include <cstdlib>
+#include <new>
+
+#include "Benchmark.h"
+
+// Global operator new/delete replacements so every benchmark can report allocations per iteration
+
+AllocationCounters g_Allocations;
+
+static void* CountedAllocate(std::size_t size)
+{
+	g_Allocations.Allocations.fetch_add(1, std::memory_order_relaxed);
+	g_Allocations.Bytes.fetch_add(size, std::memory_order_relaxed);
+	return std::malloc(size ? size : 1);
+}
+
+void* operator new(std::size_t size)
+{
+	void* p = CountedAllocate(size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size);
+}
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
@@ -0,0 +1,208 @@
+#pragma once
+// Recording stand-in for GLEW used by the benchmark build. Engine headers include <GL/glew.h> unchanged,
+// bench/mock comes first on the include path, and every call below just updates MockGLStats.
+// Only the entry points and enums the engine uses are declared, add more here as the engine grows.
+#include <cstddef>
+#include <cstdint>
+
+typedef unsigned int GLenum;
+typedef unsigned int GLuint;
+typedef int GLint;
+typedef int GLsizei;
+typedef float GLfloat;
+typedef unsigned char GLboolean;
+typedef unsigned int GLbitfield;
+typedef char GLchar;
+typedef void GLvoid;
+typedef uint64_t GLuint64;
+typedef int64_t GLint64;
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+typedef struct __GLsync* GLsync;
+
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_BLEND 0x0BE2
+#define GL_CLAMP_TO_EDGE 0x812F
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#define GL_COLOR_BUFFER_BIT 0x00004000
+#define GL_COPY_WRITE_BUFFER 0x8F37
+#define GL_CULL_FACE 0x0B44
+#define GL_DEPTH24_STENCIL8 0x88F0
+#define GL_DEPTH_BUFFER_BIT 0x00000100
+#define GL_DEPTH_STENCIL_ATTACHMENT 0x821A
+#define GL_DEPTH_TEST 0x0B71
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_FALSE 0
+#define GL_FILL 0x1B02
+#define GL_FLOAT 0x1406
+#define GL_FRAGMENT_SHADER 0x8B30
+#define GL_FRAMEBUFFER 0x8D40
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#define GL_FRONT_AND_BACK 0x0408
+#define GL_INT 0x1404
+#define GL_INVALID_INDEX 0xFFFFFFFFu
+#define GL_LINE 0x1B01
+#define GL_LINEAR 0x2601
+#define GL_LINEAR_MIPMAP_LINEAR 0x2703
+#define GL_LINK_STATUS 0x8B82
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_MAP_INVALIDATE_RANGE_BIT 0x0004
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_UNSYNCHRONIZED_BIT 0x0020
+#define GL_MAP_WRITE_BIT 0x0002
+#define GL_MAX_ARRAY_TEXTURE_LAYERS 0x88FF
+#define GL_PACK_ALIGNMENT 0x0D05
+#define GL_QUERY_RESULT 0x8866
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#define GL_R8 0x8229
+#define GL_RED 0x1903
+#define GL_RENDERBUFFER 0x8D41
+#define GL_REPEAT 0x2901
+#define GL_RGB 0x1907
+#define GL_RGB8 0x8051
+#define GL_RGBA 0x1908
+#define GL_RGBA8 0x8058
+#define GL_STATIC_DRAW 0x88E4
+#define GL_STREAM_DRAW 0x88E0
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_TEXTURE0 0x84C0
+#define GL_TEXTURE_2D 0x0DE1
+#define GL_TEXTURE_2D_ARRAY 0x8C1A
+#define GL_TEXTURE_HEIGHT 0x1001
+#define GL_TEXTURE_INTERNAL_FORMAT 0x1003
+#define GL_TEXTURE_MAG_FILTER 0x2800
+#define GL_TEXTURE_MIN_FILTER 0x2801
+#define GL_TEXTURE_WIDTH 0x1000
+#define GL_TEXTURE_WRAP_S 0x2802
+#define GL_TEXTURE_WRAP_T 0x2803
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_TIME_ELAPSED 0x88BF
+#define GL_TRIANGLES 0x0004
+#define GL_UNIFORM_BUFFER 0x8A11
+#define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 0x8A34
+#define GL_UNPACK_ALIGNMENT 0x0CF5
+#define GL_UNSIGNED_BYTE 0x1401
+#define GL_UNSIGNED_INT 0x1405
+#define GL_VERTEX_SHADER 0x8B31
+#define GL_TRUE 1
+#define GL_ALREADY_SIGNALED 0x911A
+#define GL_CONDITION_SATISFIED 0x911C
+#define GL_WAIT_FAILED 0x911D
+
+struct MockGLStats
+{
+	uint64_t Calls = 0;         // Every GL entry point
+	uint64_t DrawCalls = 0;
+	uint64_t TextureBinds = 0;  // glBindTexture
+	uint64_t UniformSets = 0;   // glUniform*
+	uint64_t StateChanges = 0;  // Program, VAO, buffer and active texture changes
+	uint64_t UploadBytes = 0;   // Buffer and texture data handed to the driver
+};
+extern MockGLStats g_MockGL;
+void MockGLReset();
+
+// Version and extension flags, all off by default so the GL 3.3 paths are measured
+extern GLboolean g_MockGLEW_VERSION_4_0;
+extern GLboolean g_MockGLEW_ARB_buffer_storage;
+extern GLboolean g_MockGLEW_ARB_bindless_texture;
+extern GLboolean g_MockGLEW_ARB_texture_storage;
+extern GLboolean g_MockGLEW_ARB_texture_view;
+#define GLEW_VERSION_4_0 g_MockGLEW_VERSION_4_0
+#define GLEW_ARB_buffer_storage g_MockGLEW_ARB_buffer_storage
+#define GLEW_ARB_bindless_texture g_MockGLEW_ARB_bindless_texture
+#define GLEW_ARB_texture_storage g_MockGLEW_ARB_texture_storage
+#define GLEW_ARB_texture_view g_MockGLEW_ARB_texture_view
+
+// Shaders
+GLuint glCreateShader(GLenum type);
+void glShaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length);
+void glCompileShader(GLuint shader);
+void glDeleteShader(GLuint shader);
+GLuint glCreateProgram();
+void glAttachShader(GLuint program, GLuint shader);
+void glLinkProgram(GLuint program);
+void glValidateProgram(GLuint program);
+void glDeleteProgram(GLuint program);
+void glGetProgramiv(GLuint program, GLenum pname, GLint* params);
+void glGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog);
+void glUseProgram(GLuint program);
+GLint glGetUniformLocation(GLuint program, const GLchar* name);
+GLuint glGetUniformBlockIndex(GLuint program, const GLchar* uniformBlockName);
+void glUniformBlockBinding(GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding);
+void glUniform1i(GLint location, GLint v0);
+void glUniform1f(GLint location, GLfloat v0);
+void glUniform2f(GLint location, GLfloat v0, GLfloat v1);
+void glUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+void glUniform3fv(GLint location, GLsizei count, const GLfloat* value);
+void glUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+void glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+
+// Buffers and vertex arrays
+void glGenBuffers(GLsizei n, GLuint* buffers);
+void glDeleteBuffers(GLsizei n, const GLuint* buffers);
+void glBindBuffer(GLenum target, GLuint buffer);
+void glBindBufferBase(GLenum target, GLuint index, GLuint buffer);
+void glBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+void glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+void glBufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+void* glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+GLboolean glUnmapBuffer(GLenum target);
+void glGenVertexArrays(GLsizei n, GLuint* arrays);
+void glDeleteVertexArrays(GLsizei n, const GLuint* arrays);
+void glBindVertexArray(GLuint array);
+void glEnableVertexAttribArray(GLuint index);
+void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer);
+void glVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer);
+void glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+void glDrawArrays(GLenum mode, GLint first, GLsizei count);
+
+// Textures
+void glGenTextures(GLsizei n, GLuint* textures);
+void glDeleteTextures(GLsizei n, const GLuint* textures);
+void glActiveTexture(GLenum texture);
+void glBindTexture(GLenum target, GLuint texture);
+void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels);
+void glTexImage3D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels);
+void glTexStorage3D(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+void glTextureView(GLuint texture, GLenum target, GLuint origtexture, GLenum internalformat, GLuint minlevel, GLuint numlevels, GLuint minlayer, GLuint numlayers);
+void glTexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels);
+void glGetTexImage(GLenum target, GLint level, GLenum format, GLenum type, void* pixels);
+void glGetTexLevelParameteriv(GLenum target, GLint level, GLenum pname, GLint* params);
+void glTexParameteri(GLenum target, GLenum pname, GLint param);
+void glGenerateMipmap(GLenum target);
+void glPixelStorei(GLenum pname, GLint param);
+GLuint64 glGetTextureHandleARB(GLuint texture);
+void glMakeTextureHandleResidentARB(GLuint64 handle);
+void glMakeTextureHandleNonResidentARB(GLuint64 handle);
+
+// Framebuffers
+void glGenFramebuffers(GLsizei n, GLuint* framebuffers);
+void glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers);
+void glBindFramebuffer(GLenum target, GLuint framebuffer);
+void glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+void glFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer);
+GLenum glCheckFramebufferStatus(GLenum target);
+void glGenRenderbuffers(GLsizei n, GLuint* renderbuffers);
+void glDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers);
+void glBindRenderbuffer(GLenum target, GLuint renderbuffer);
+void glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
+
+// Queries, sync and state
+void glGenQueries(GLsizei n, GLuint* ids);
+void glDeleteQueries(GLsizei n, const GLuint* ids);
+void glBeginQuery(GLenum target, GLuint id);
+void glEndQuery(GLenum target);
+void glGetQueryObjectiv(GLuint id, GLenum pname, GLint* params);
+void glGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params);
+GLsync glFenceSync(GLenum condition, GLbitfield flags);
+GLenum glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout);
+void glDeleteSync(GLsync sync);
+void glGetIntegerv(GLenum pname, GLint* data);
+void glEnable(GLenum cap);
+void glDisable(GLenum cap);
+void glViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+void glClear(GLbitfield mask);
+void glPolygonMode(GLenum face, GLenum mode);
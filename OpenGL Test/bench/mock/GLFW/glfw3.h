@@ -0,0 +1,4 @@
+#pragma once
+// Benchmark build stand-in for GLFW, engine code only needs the timer outside of MainLoop.h
+
+double glfwGetTime();
@@ -0,0 +1,250 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <vector>
+
+MockGLStats g_MockGL;
+GLboolean g_MockGLEW_VERSION_4_0 = GL_FALSE;
+GLboolean g_MockGLEW_ARB_buffer_storage = GL_FALSE;
+GLboolean g_MockGLEW_ARB_bindless_texture = GL_FALSE;
+GLboolean g_MockGLEW_ARB_texture_storage = GL_FALSE;
+GLboolean g_MockGLEW_ARB_texture_view = GL_FALSE;
+
+namespace
+{
+	GLuint s_NextID = 1;
+	GLint s_NextLocation = 0;
+	std::map<GLuint, std::vector<unsigned char>> s_Buffers; // Backing store so mapped writes land somewhere
+	std::map<GLenum, GLuint> s_BoundBuffers;
+	struct MockTexture
+	{
+		GLsizei Width = 0;
+		GLsizei Height = 0;
+		GLint InternalFormat = 0;
+	};
+	std::map<GLuint, MockTexture> s_Textures; // Level 0 of 2D textures and arrays, for glGetTexLevelParameteriv
+	GLuint s_BoundTexture2D = 0;
+	GLuint s_BoundTexture2DArray = 0;
+	unsigned char s_Sync; // Fences only need a unique non-null address
+
+	void Generate(GLsizei n, GLuint* ids)
+	{
+		g_MockGL.Calls++;
+		for (GLsizei i = 0; i < n; i++)
+			ids[i] = s_NextID++;
+	}
+	void Call() { g_MockGL.Calls++; }
+	void State() { g_MockGL.Calls++; g_MockGL.StateChanges++; }
+	void Uniform() { g_MockGL.Calls++; g_MockGL.UniformSets++; }
+}
+
+void MockGLReset()
+{
+	g_MockGL = MockGLStats();
+}
+
+double glfwGetTime()
+{
+	using namespace std::chrono;
+	return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Shaders
+GLuint glCreateShader(GLenum) { Call(); return s_NextID++; }
+void glShaderSource(GLuint, GLsizei, const GLchar* const*, const GLint*) { Call(); }
+void glCompileShader(GLuint) { Call(); }
+void glDeleteShader(GLuint) { Call(); }
+GLuint glCreateProgram() { Call(); return s_NextID++; }
+void glAttachShader(GLuint, GLuint) { Call(); }
+void glLinkProgram(GLuint) { Call(); }
+void glValidateProgram(GLuint) { Call(); }
+void glDeleteProgram(GLuint) { Call(); }
+void glGetProgramiv(GLuint, GLenum, GLint* params) { Call(); *params = GL_TRUE; }
+void glGetProgramInfoLog(GLuint, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+{
+	Call();
+	if (length)
+		*length = 0;
+	if (bufSize > 0)
+		infoLog[0] = '\0';
+}
+void glUseProgram(GLuint) { State(); }
+GLint glGetUniformLocation(GLuint, const GLchar*) { Call(); return s_NextLocation++; }
+GLuint glGetUniformBlockIndex(GLuint, const GLchar*) { Call(); return 0; }
+void glUniformBlockBinding(GLuint, GLuint, GLuint) { Call(); }
+void glUniform1i(GLint, GLint) { Uniform(); }
+void glUniform1f(GLint, GLfloat) { Uniform(); }
+void glUniform2f(GLint, GLfloat, GLfloat) { Uniform(); }
+void glUniform3f(GLint, GLfloat, GLfloat, GLfloat) { Uniform(); }
+void glUniform3fv(GLint, GLsizei, const GLfloat*) { Uniform(); }
+void glUniform4f(GLint, GLfloat, GLfloat, GLfloat, GLfloat) { Uniform(); }
+void glUniformMatrix4fv(GLint, GLsizei, GLboolean, const GLfloat*) { Uniform(); }
+
+// Buffers and vertex arrays
+void glGenBuffers(GLsizei n, GLuint* buffers) { Generate(n, buffers); }
+void glDeleteBuffers(GLsizei n, const GLuint* buffers)
+{
+	Call();
+	for (GLsizei i = 0; i < n; i++)
+		s_Buffers.erase(buffers[i]);
+}
+void glBindBuffer(GLenum target, GLuint buffer) { State(); s_BoundBuffers[target] = buffer; }
+void glBindBufferBase(GLenum, GLuint, GLuint) { State(); }
+void glBindBufferRange(GLenum, GLuint, GLuint, GLintptr, GLsizeiptr) { State(); }
+void glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum)
+{
+	Call();
+	std::vector<unsigned char>& store = s_Buffers[s_BoundBuffers[target]];
+	store.assign(static_cast<size_t>(size), 0);
+	if (data)
+	{
+		std::memcpy(store.data(), data, static_cast<size_t>(size));
+		g_MockGL.UploadBytes += size;
+	}
+}
+void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	Call();
+	std::memcpy(s_Buffers[s_BoundBuffers[target]].data() + offset, data, static_cast<size_t>(size));
+	g_MockGL.UploadBytes += size;
+}
+void glBufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield)
+{
+	glBufferData(target, size, data, 0);
+}
+void* glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield)
+{
+	Call();
+	g_MockGL.UploadBytes += length;
+	return s_Buffers[s_BoundBuffers[target]].data() + offset;
+}
+GLboolean glUnmapBuffer(GLenum) { Call(); return GL_TRUE; }
+void glGenVertexArrays(GLsizei n, GLuint* arrays) { Generate(n, arrays); }
+void glDeleteVertexArrays(GLsizei, const GLuint*) { Call(); }
+void glBindVertexArray(GLuint) { State(); }
+void glEnableVertexAttribArray(GLuint) { Call(); }
+void glVertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) { Call(); }
+void glVertexAttribIPointer(GLuint, GLint, GLenum, GLsizei, const void*) { Call(); }
+void glDrawElements(GLenum, GLsizei, GLenum, const void*) { Call(); g_MockGL.DrawCalls++; }
+void glDrawArrays(GLenum, GLint, GLsizei) { Call(); g_MockGL.DrawCalls++; }
+
+// Textures
+void glGenTextures(GLsizei n, GLuint* textures) { Generate(n, textures); }
+void glDeleteTextures(GLsizei n, const GLuint* textures)
+{
+	Call();
+	for (GLsizei i = 0; i < n; i++)
+		s_Textures.erase(textures[i]);
+}
+void glActiveTexture(GLenum) { State(); }
+void glBindTexture(GLenum target, GLuint texture)
+{
+	Call();
+	g_MockGL.TextureBinds++;
+	if (target == GL_TEXTURE_2D)
+		s_BoundTexture2D = texture;
+	else if (target == GL_TEXTURE_2D_ARRAY)
+		s_BoundTexture2DArray = texture;
+}
+void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint, GLenum, GLenum, const void* pixels)
+{
+	Call();
+	if (target == GL_TEXTURE_2D && level == 0)
+	{
+		MockTexture& texture = s_Textures[s_BoundTexture2D];
+		texture.Width = width;
+		texture.Height = height;
+		texture.InternalFormat = internalformat;
+	}
+	if (pixels)
+		g_MockGL.UploadBytes += static_cast<uint64_t>(width) * height * 4;
+}
+void glTexImage3D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei, GLint, GLenum, GLenum, const void*)
+{
+	Call();
+	if (target == GL_TEXTURE_2D_ARRAY && level == 0)
+	{
+		MockTexture& texture = s_Textures[s_BoundTexture2DArray];
+		texture.Width = width;
+		texture.Height = height;
+		texture.InternalFormat = internalformat;
+	}
+}
+void glTexStorage3D(GLenum target, GLsizei, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth)
+{
+	glTexImage3D(target, 0, static_cast<GLint>(internalformat), width, height, depth, 0, 0, 0, nullptr);
+}
+void glTextureView(GLuint texture, GLenum, GLuint origtexture, GLenum internalformat, GLuint, GLuint, GLuint, GLuint)
+{
+	Call();
+	MockTexture view = s_Textures[origtexture];
+	view.InternalFormat = static_cast<GLint>(internalformat);
+	s_Textures[texture] = view;
+}
+void glTexSubImage3D(GLenum, GLint, GLint, GLint, GLint, GLsizei width, GLsizei height, GLsizei depth, GLenum, GLenum, const void*)
+{
+	Call();
+	g_MockGL.UploadBytes += static_cast<uint64_t>(width) * height * depth * 4;
+}
+void glGetTexImage(GLenum, GLint, GLenum, GLenum, void*) { Call(); }
+void glGetTexLevelParameteriv(GLenum, GLint, GLenum pname, GLint* params)
+{
+	Call();
+	const MockTexture& texture = s_Textures[s_BoundTexture2D];
+	if (pname == GL_TEXTURE_WIDTH)
+		*params = texture.Width;
+	else if (pname == GL_TEXTURE_HEIGHT)
+		*params = texture.Height;
+	else if (pname == GL_TEXTURE_INTERNAL_FORMAT)
+		*params = texture.InternalFormat;
+	else
+		*params = 0;
+}
+void glTexParameteri(GLenum, GLenum, GLint) { Call(); }
+void glGenerateMipmap(GLenum) { Call(); }
+void glPixelStorei(GLenum, GLint) { Call(); }
+GLuint64 glGetTextureHandleARB(GLuint texture) { Call(); return 0x100000000ull | texture; }
+void glMakeTextureHandleResidentARB(GLuint64) { Call(); }
+void glMakeTextureHandleNonResidentARB(GLuint64) { Call(); }
+
+// Framebuffers
+void glGenFramebuffers(GLsizei n, GLuint* framebuffers) { Generate(n, framebuffers); }
+void glDeleteFramebuffers(GLsizei, const GLuint*) { Call(); }
+void glBindFramebuffer(GLenum, GLuint) { State(); }
+void glFramebufferTexture2D(GLenum, GLenum, GLenum, GLuint, GLint) { Call(); }
+void glFramebufferRenderbuffer(GLenum, GLenum, GLenum, GLuint) { Call(); }
+GLenum glCheckFramebufferStatus(GLenum) { Call(); return GL_FRAMEBUFFER_COMPLETE; }
+void glGenRenderbuffers(GLsizei n, GLuint* renderbuffers) { Generate(n, renderbuffers); }
+void glDeleteRenderbuffers(GLsizei, const GLuint*) { Call(); }
+void glBindRenderbuffer(GLenum, GLuint) { State(); }
+void glRenderbufferStorage(GLenum, GLenum, GLsizei, GLsizei) { Call(); }
+
+// Queries, sync and state
+void glGenQueries(GLsizei n, GLuint* ids) { Generate(n, ids); }
+void glDeleteQueries(GLsizei, const GLuint*) { Call(); }
+void glBeginQuery(GLenum, GLuint) { Call(); }
+void glEndQuery(GLenum) { Call(); }
+void glGetQueryObjectiv(GLuint, GLenum, GLint* params) { Call(); *params = 1; }
+void glGetQueryObjectui64v(GLuint, GLenum, GLuint64* params) { Call(); *params = 8000000; } // Pretend every frame takes 8ms
+GLsync glFenceSync(GLenum, GLbitfield) { Call(); return reinterpret_cast<GLsync>(&s_Sync); }
+GLenum glClientWaitSync(GLsync, GLbitfield, GLuint64) { Call(); return GL_ALREADY_SIGNALED; }
+void glDeleteSync(GLsync) { Call(); }
+void glGetIntegerv(GLenum pname, GLint* data)
+{
+	Call();
+	if (pname == GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT)
+		*data = 256;
+	else if (pname == GL_MAX_ARRAY_TEXTURE_LAYERS)
+		*data = 2048;
+	else
+		*data = 0;
+}
+void glEnable(GLenum) { State(); }
+void glDisable(GLenum) { State(); }
+void glViewport(GLint, GLint, GLsizei, GLsizei) { State(); }
+void glClearColor(GLfloat, GLfloat, GLfloat, GLfloat) { State(); }
+void glClear(GLbitfield) { Call(); }
+void glPolygonMode(GLenum, GLenum) { State(); }
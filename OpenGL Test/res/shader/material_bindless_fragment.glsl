@@ -0,0 +1,28 @@
+#version 400 core
+#extension GL_ARB_bindless_texture : require
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+#define MAX_MATERIALS 256
+
+struct Material
+{
+    ivec4 array;      // Only used by the texture array shader
+    ivec4 layer;
+    uvec4 handles[2]; // (diffuse, specular), (normal, height)
+};
+layout (std140) uniform Materials
+{
+    Material materials[MAX_MATERIALS];
+};
+uniform int materialIndex;
+
+void main()
+{
+    uvec2 diffuse = materials[materialIndex].handles[0].xy;
+    if (diffuse == uvec2(0u))
+        FragColor = vec4(1.0);
+    else
+        FragColor = texture(sampler2D(diffuse), TexCoords);
+}
\ No newline at end of file
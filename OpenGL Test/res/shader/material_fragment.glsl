@@ -0,0 +1,41 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+#define MAX_TEXTURE_ARRAYS 4
+#define MAX_MATERIALS 256
+
+struct Material
+{
+    ivec4 array;     // diffuse, specular, normal, height
+    ivec4 layer;
+    uvec4 handles[2]; // Only used by the bindless shader
+};
+layout (std140) uniform Materials
+{
+    Material materials[MAX_MATERIALS];
+};
+uniform int materialIndex;
+uniform sampler2DArray textureArrays[MAX_TEXTURE_ARRAYS];
+
+vec4 SampleArray(int array, int layer, vec2 uv)
+{
+    // GLSL 3.30 only allows constant indices into sampler arrays
+    vec3 coord = vec3(uv, layer);
+    if (array == 0)
+        return texture(textureArrays[0], coord);
+    if (array == 1)
+        return texture(textureArrays[1], coord);
+    if (array == 2)
+        return texture(textureArrays[2], coord);
+    if (array == 3)
+        return texture(textureArrays[3], coord);
+    return vec4(1.0);
+}
+
+void main()
+{
+    Material material = materials[materialIndex];
+    FragColor = SampleArray(material.array.x, material.layer.x, TexCoords);
+}
\ No newline at end of file
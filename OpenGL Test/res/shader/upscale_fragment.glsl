@@ -0,0 +1,31 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D screenTexture;
+uniform vec2 uvScale;   // Rendered region of the target, in UV space
+uniform vec2 texelSize; // 1.0 / render target size
+uniform float sharpness;
+
+vec3 Sample(vec2 uv)
+{
+    // Keep taps inside the rendered region so stale pixels outside it never bleed in
+    return texture(screenTexture, clamp(uv, 0.5 * texelSize, uvScale - 0.5 * texelSize)).rgb;
+}
+
+void main()
+{
+    vec2 uv = TexCoords * uvScale;
+    vec3 center = Sample(uv);
+    vec3 north = Sample(uv + vec2(0.0, texelSize.y));
+    vec3 south = Sample(uv - vec2(0.0, texelSize.y));
+    vec3 east = Sample(uv + vec2(texelSize.x, 0.0));
+    vec3 west = Sample(uv - vec2(texelSize.x, 0.0));
+
+    // Unsharp mask on top of the bilinear upscale, clamped to the neighbourhood to avoid ringing
+    vec3 sharpened = center + (4.0 * center - north - south - east - west) * sharpness;
+    vec3 lo = min(center, min(min(north, south), min(east, west)));
+    vec3 hi = max(center, max(max(north, south), max(east, west)));
+    FragColor = vec4(clamp(sharpened, lo, hi), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 330 core
+out vec2 TexCoords;
+
+// Fullscreen triangle generated from gl_VertexID, no vertex buffer needed
+void main()
+{
+    TexCoords = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(TexCoords * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,721 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_USE_SSE
+#include <emmintrin.h>
+#endif
+
+#define BVH_BIN_COUNT 16
+#define BVH_TRAVERSAL_COST 1.0f // Node visit relative to one primitive test
+#define BVH_MIN_LEAF_SIZE 2     // Never split below this
+#define BVH_MAX_LEAF_SIZE 16    // Always split above this, when a split exists
+#define BVH_STACK_SIZE 64       // Traversal stack entries, also caps the tree depth
+
+struct AABB
+{
+	glm::vec3 Min = glm::vec3(FLT_MAX);
+	glm::vec3 Max = glm::vec3(-FLT_MAX);
+
+	void Grow(const glm::vec3& point)
+	{
+		Min = glm::min(Min, point);
+		Max = glm::max(Max, point);
+	}
+	void Grow(const AABB& box)
+	{
+		Min = glm::min(Min, box.Min);
+		Max = glm::max(Max, box.Max);
+	}
+	float HalfArea() const
+	{
+		if (Min.x > Max.x)
+			return 0.0f;
+		glm::vec3 extent = Max - Min;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+};
+
+// 32 bytes, two nodes per cache line. Children are always allocated as an adjacent pair
+struct BVHNode
+{
+	glm::vec3 BoundsMin;
+	unsigned int LeftFirst; // Left child for interior nodes, first primitive for leaves
+	glm::vec3 BoundsMax;
+	unsigned int Count;     // Primitive count, 0 for interior nodes
+
+	bool IsLeaf() const { return Count > 0; }
+};
+static_assert(sizeof(BVHNode) == 32, "BVHNode must stay 32 bytes");
+
+struct Ray
+{
+	glm::vec3 Origin;
+	glm::vec3 Direction;
+	float TMax = FLT_MAX;
+};
+struct RayHit
+{
+	float t = FLT_MAX;
+	float u = 0.0f, v = 0.0f;
+	unsigned int Triangle = ~0u; // Triangle index in the mesh's index buffer (indices[3 * Triangle])
+	unsigned int Instance = ~0u; // Only set by TopLevelBVH
+
+	bool Hit() const { return Triangle != ~0u; }
+};
+
+// Four rays in SoA layout, traversed together. Works best for coherent rays (AO hemispheres, pixel blocks)
+struct RayPacket4
+{
+	float OriginX[4], OriginY[4], OriginZ[4];
+	float DirectionX[4], DirectionY[4], DirectionZ[4];
+	float TMax[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+
+	void Set(int lane, const Ray& ray)
+	{
+		OriginX[lane] = ray.Origin.x; OriginY[lane] = ray.Origin.y; OriginZ[lane] = ray.Origin.z;
+		DirectionX[lane] = ray.Direction.x; DirectionY[lane] = ray.Direction.y; DirectionZ[lane] = ray.Direction.z;
+		TMax[lane] = ray.TMax;
+	}
+	Ray Get(int lane) const
+	{
+		Ray ray;
+		ray.Origin = glm::vec3(OriginX[lane], OriginY[lane], OriginZ[lane]);
+		ray.Direction = glm::vec3(DirectionX[lane], DirectionY[lane], DirectionZ[lane]);
+		ray.TMax = TMax[lane];
+		return ray;
+	}
+};
+struct RayHit4
+{
+	RayHit Hits[4];
+};
+
+// Binned SAH builder shared by the mesh and instance BVHs. Large subtrees are built on separate threads,
+// unless the caller is already building several BVHs in parallel
+class BVHBuilder
+{
+public:
+	BVHBuilder(const std::vector<AABB>& bounds, std::vector<BVHNode>& nodes, std::vector<unsigned int>& indices, bool parallel = true)
+		: m_Bounds(bounds), m_Nodes(nodes), m_Indices(indices), m_NodesUsed(2)
+	{
+		unsigned int threads = parallel ? std::max(1u, std::thread::hardware_concurrency()) : 1u;
+		m_MaxParallelDepth = 0;
+		while ((1u << m_MaxParallelDepth) < threads)
+			m_MaxParallelDepth++;
+	}
+	void Build()
+	{
+		unsigned int count = static_cast<unsigned int>(m_Bounds.size());
+		m_Nodes.clear();
+		m_Indices.resize(count);
+		if (count == 0)
+			return;
+
+		m_Centroids.resize(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			m_Indices[i] = i;
+			m_Centroids[i] = (m_Bounds[i].Min + m_Bounds[i].Max) * 0.5f;
+		}
+
+		// Node 1 is left unused so every sibling pair shares a cache line
+		m_Nodes.resize(2 * count);
+		BVHNode& root = m_Nodes[0];
+		root.LeftFirst = 0;
+		root.Count = count;
+		m_NodesUsed = 2;
+		Subdivide(0, 0);
+		m_Nodes.resize(m_NodesUsed);
+	}
+
+private:
+	const std::vector<AABB>& m_Bounds;
+	std::vector<glm::vec3> m_Centroids;
+	std::vector<BVHNode>& m_Nodes;
+	std::vector<unsigned int>& m_Indices;
+	std::atomic<unsigned int> m_NodesUsed;
+	int m_MaxParallelDepth;
+
+	static const unsigned int parallelThreshold = 4096; // Below this a thread costs more than it saves
+
+	void Subdivide(unsigned int nodeIndex, int depth)
+	{
+		BVHNode& node = m_Nodes[nodeIndex];
+		AABB bounds, centroidBounds;
+		for (unsigned int i = 0; i < node.Count; i++)
+		{
+			unsigned int prim = m_Indices[node.LeftFirst + i];
+			bounds.Grow(m_Bounds[prim]);
+			centroidBounds.Grow(m_Centroids[prim]);
+		}
+		node.BoundsMin = bounds.Min;
+		node.BoundsMax = bounds.Max;
+		// Skewed input can't grow the tree deeper than the traversal stacks, it gets a larger leaf instead
+		if (node.Count <= BVH_MIN_LEAF_SIZE || depth >= BVH_STACK_SIZE - 1)
+			return;
+
+		// Costs are in units of one primitive test times the node's half area
+		int axis;
+		unsigned int splitBin;
+		float splitCost = FindBestSplit(node, centroidBounds, axis, splitBin);
+		if (splitCost == FLT_MAX)
+			return;
+		float leafCost = node.Count * bounds.HalfArea();
+		if (splitCost + BVH_TRAVERSAL_COST * bounds.HalfArea() >= leafCost && node.Count <= BVH_MAX_LEAF_SIZE)
+			return;
+
+		float binScale = BVH_BIN_COUNT / (centroidBounds.Max[axis] - centroidBounds.Min[axis]);
+		unsigned int* first = &m_Indices[node.LeftFirst];
+		unsigned int* middle = std::partition(first, first + node.Count, [&](unsigned int prim)
+			{
+				return Bin(m_Centroids[prim][axis], centroidBounds.Min[axis], binScale) < splitBin;
+			});
+		unsigned int leftCount = static_cast<unsigned int>(middle - first);
+		if (leftCount == 0 || leftCount == node.Count)
+			return;
+
+		unsigned int leftIndex = m_NodesUsed.fetch_add(2);
+		m_Nodes[leftIndex].LeftFirst = node.LeftFirst;
+		m_Nodes[leftIndex].Count = leftCount;
+		m_Nodes[leftIndex + 1].LeftFirst = node.LeftFirst + leftCount;
+		m_Nodes[leftIndex + 1].Count = node.Count - leftCount;
+		node.LeftFirst = leftIndex;
+		node.Count = 0;
+
+		if (depth < m_MaxParallelDepth && m_Nodes[leftIndex].Count > parallelThreshold && m_Nodes[leftIndex + 1].Count > parallelThreshold)
+		{
+			std::future<void> left = std::async(std::launch::async, [this, leftIndex, depth]() { Subdivide(leftIndex, depth + 1); });
+			Subdivide(leftIndex + 1, depth + 1);
+			left.wait();
+		}
+		else
+		{
+			Subdivide(leftIndex, depth + 1);
+			Subdivide(leftIndex + 1, depth + 1);
+		}
+	}
+	float FindBestSplit(const BVHNode& node, const AABB& centroidBounds, int& bestAxis, unsigned int& bestBin) const
+	{
+		float bestCost = FLT_MAX;
+		bestAxis = 0;
+		bestBin = 1;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float boundsMin = centroidBounds.Min[axis];
+			float extent = centroidBounds.Max[axis] - boundsMin;
+			if (extent <= 0.0f)
+				continue;
+
+			AABB bins[BVH_BIN_COUNT];
+			unsigned int counts[BVH_BIN_COUNT] = {};
+			float binScale = BVH_BIN_COUNT / extent;
+			for (unsigned int i = 0; i < node.Count; i++)
+			{
+				unsigned int prim = m_Indices[node.LeftFirst + i];
+				unsigned int bin = Bin(m_Centroids[prim][axis], boundsMin, binScale);
+				counts[bin]++;
+				bins[bin].Grow(m_Bounds[prim]);
+			}
+
+			// Sweep from both sides to get the SAH cost of every plane between bins
+			float leftArea[BVH_BIN_COUNT - 1], rightArea[BVH_BIN_COUNT - 1];
+			unsigned int leftCount[BVH_BIN_COUNT - 1], rightCount[BVH_BIN_COUNT - 1];
+			AABB leftBox, rightBox;
+			unsigned int leftSum = 0, rightSum = 0;
+			for (int i = 0; i < BVH_BIN_COUNT - 1; i++)
+			{
+				leftSum += counts[i];
+				leftCount[i] = leftSum;
+				leftBox.Grow(bins[i]);
+				leftArea[i] = leftBox.HalfArea();
+				rightSum += counts[BVH_BIN_COUNT - 1 - i];
+				rightCount[BVH_BIN_COUNT - 2 - i] = rightSum;
+				rightBox.Grow(bins[BVH_BIN_COUNT - 1 - i]);
+				rightArea[BVH_BIN_COUNT - 2 - i] = rightBox.HalfArea();
+			}
+			for (int i = 0; i < BVH_BIN_COUNT - 1; i++)
+			{
+				float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+				if (leftCount[i] > 0 && rightCount[i] > 0 && cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = i + 1;
+				}
+			}
+		}
+		return bestCost;
+	}
+	static unsigned int Bin(float centroid, float boundsMin, float binScale)
+	{
+		int bin = static_cast<int>((centroid - boundsMin) * binScale);
+		return static_cast<unsigned int>(std::min(std::max(bin, 0), BVH_BIN_COUNT - 1));
+	}
+};
+
+// Slab tests shared by both BVH levels. Return the entry distance, or FLT_MAX on a miss
+inline float IntersectAABB(const Ray& ray, const glm::vec3& invDirection, const BVHNode& node, float tMax)
+{
+	float tx1 = (node.BoundsMin.x - ray.Origin.x) * invDirection.x, tx2 = (node.BoundsMax.x - ray.Origin.x) * invDirection.x;
+	float tNear = std::min(tx1, tx2), tFar = std::max(tx1, tx2);
+	float ty1 = (node.BoundsMin.y - ray.Origin.y) * invDirection.y, ty2 = (node.BoundsMax.y - ray.Origin.y) * invDirection.y;
+	tNear = std::max(tNear, std::min(ty1, ty2)), tFar = std::min(tFar, std::max(ty1, ty2));
+	float tz1 = (node.BoundsMin.z - ray.Origin.z) * invDirection.z, tz2 = (node.BoundsMax.z - ray.Origin.z) * invDirection.z;
+	tNear = std::max(tNear, std::min(tz1, tz2)), tFar = std::min(tFar, std::max(tz1, tz2));
+	if (tFar >= tNear && tNear < tMax && tFar > 0.0f)
+		return tNear;
+	return FLT_MAX;
+}
+
+#ifdef BVH_USE_SSE
+struct RayPacket4SSE
+{
+	__m128 OriginX, OriginY, OriginZ;
+	__m128 DirectionX, DirectionY, DirectionZ;
+	__m128 InvDirectionX, InvDirectionY, InvDirectionZ;
+
+	explicit RayPacket4SSE(const RayPacket4& packet)
+	{
+		__m128 one = _mm_set1_ps(1.0f);
+		OriginX = _mm_loadu_ps(packet.OriginX); OriginY = _mm_loadu_ps(packet.OriginY); OriginZ = _mm_loadu_ps(packet.OriginZ);
+		DirectionX = _mm_loadu_ps(packet.DirectionX); DirectionY = _mm_loadu_ps(packet.DirectionY); DirectionZ = _mm_loadu_ps(packet.DirectionZ);
+		InvDirectionX = _mm_div_ps(one, DirectionX); InvDirectionY = _mm_div_ps(one, DirectionY); InvDirectionZ = _mm_div_ps(one, DirectionZ);
+	}
+};
+
+// Bitmask of the lanes whose ray enters the node before their current closest hit
+inline int IntersectAABB4(const RayPacket4SSE& rays, const BVHNode& node, __m128 tMax)
+{
+	__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.BoundsMin.x), rays.OriginX), rays.InvDirectionX);
+	__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.BoundsMax.x), rays.OriginX), rays.InvDirectionX);
+	__m128 tNear = _mm_min_ps(t1, t2), tFar = _mm_max_ps(t1, t2);
+	t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.BoundsMin.y), rays.OriginY), rays.InvDirectionY);
+	t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.BoundsMax.y), rays.OriginY), rays.InvDirectionY);
+	tNear = _mm_max_ps(tNear, _mm_min_ps(t1, t2)), tFar = _mm_min_ps(tFar, _mm_max_ps(t1, t2));
+	t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.BoundsMin.z), rays.OriginZ), rays.InvDirectionZ);
+	t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.BoundsMax.z), rays.OriginZ), rays.InvDirectionZ);
+	tNear = _mm_max_ps(tNear, _mm_min_ps(t1, t2)), tFar = _mm_min_ps(tFar, _mm_max_ps(t1, t2));
+	__m128 mask = _mm_and_ps(_mm_cmpge_ps(tFar, tNear), _mm_and_ps(_mm_cmplt_ps(tNear, tMax), _mm_cmpgt_ps(tFar, _mm_setzero_ps())));
+	return _mm_movemask_ps(mask);
+}
+#endif
+
+// Per-mesh triangle BVH, built once at import and kept with the mesh
+class BVH
+{
+public:
+	// Pass parallel = false when building several BVHs on separate threads already
+	template<typename VertexType>
+	void Build(const std::vector<VertexType>& vertices, const std::vector<unsigned int>& indices, bool parallel = true)
+	{
+		unsigned int triangleCount = static_cast<unsigned int>(indices.size() / 3);
+		std::vector<AABB> bounds(triangleCount);
+		std::vector<Triangle> triangles(triangleCount);
+		for (unsigned int i = 0; i < triangleCount; i++)
+		{
+			glm::vec3 v0 = vertices[indices[3 * i]].Position;
+			glm::vec3 v1 = vertices[indices[3 * i + 1]].Position;
+			glm::vec3 v2 = vertices[indices[3 * i + 2]].Position;
+			bounds[i].Grow(v0);
+			bounds[i].Grow(v1);
+			bounds[i].Grow(v2);
+			triangles[i] = { v0, v1 - v0, v2 - v0 };
+		}
+		BVHBuilder(bounds, m_Nodes, m_TriangleIndices, parallel).Build();
+
+		// Store triangles in leaf order so a leaf reads one contiguous run
+		m_Triangles.resize(triangleCount);
+		for (unsigned int i = 0; i < triangleCount; i++)
+			m_Triangles[i] = triangles[m_TriangleIndices[i]];
+	}
+
+	bool Intersect(const Ray& ray, RayHit& hit) const
+	{
+		if (m_Nodes.empty())
+			return false;
+		hit.t = std::min(hit.t, ray.TMax);
+		glm::vec3 invDirection = 1.0f / ray.Direction;
+		if (IntersectAABB(ray, invDirection, m_Nodes[0], hit.t) == FLT_MAX)
+			return false;
+
+		bool found = false;
+		const BVHNode* stack[BVH_STACK_SIZE];
+		unsigned int stackPtr = 0;
+		const BVHNode* node = &m_Nodes[0];
+		while (true)
+		{
+			if (node->IsLeaf())
+			{
+				for (unsigned int i = 0; i < node->Count; i++)
+					found |= IntersectTriangle(ray, node->LeftFirst + i, hit);
+				if (stackPtr == 0)
+					break;
+				node = stack[--stackPtr];
+				continue;
+			}
+			const BVHNode* child1 = &m_Nodes[node->LeftFirst];
+			const BVHNode* child2 = &m_Nodes[node->LeftFirst + 1];
+			float dist1 = IntersectAABB(ray, invDirection, *child1, hit.t);
+			float dist2 = IntersectAABB(ray, invDirection, *child2, hit.t);
+			if (dist1 > dist2)
+			{
+				std::swap(dist1, dist2);
+				std::swap(child1, child2);
+			}
+			if (dist1 == FLT_MAX)
+			{
+				if (stackPtr == 0)
+					break;
+				node = stack[--stackPtr];
+			}
+			else
+			{
+				node = child1;
+				if (dist2 != FLT_MAX)
+					stack[stackPtr++] = child2;
+			}
+		}
+		return found;
+	}
+	void Intersect4(const RayPacket4& packet, RayHit4& hits) const
+	{
+#ifdef BVH_USE_SSE
+		if (m_Nodes.empty())
+			return;
+		RayPacket4SSE rays(packet);
+		float tMax[4];
+		for (int lane = 0; lane < 4; lane++)
+		{
+			hits.Hits[lane].t = std::min(hits.Hits[lane].t, packet.TMax[lane]);
+			tMax[lane] = hits.Hits[lane].t;
+		}
+
+		const BVHNode* stack[BVH_STACK_SIZE];
+		unsigned int stackPtr = 0;
+		const BVHNode* node = &m_Nodes[0];
+		if (!IntersectAABB4(rays, *node, _mm_loadu_ps(tMax)))
+			return;
+		while (true)
+		{
+			if (node->IsLeaf())
+			{
+				for (unsigned int i = 0; i < node->Count; i++)
+					IntersectTriangle4(rays, node->LeftFirst + i, tMax, hits);
+				if (stackPtr == 0)
+					break;
+				node = stack[--stackPtr];
+				continue;
+			}
+			__m128 t = _mm_loadu_ps(tMax);
+			const BVHNode* child1 = &m_Nodes[node->LeftFirst];
+			const BVHNode* child2 = &m_Nodes[node->LeftFirst + 1];
+			int mask1 = IntersectAABB4(rays, *child1, t);
+			int mask2 = IntersectAABB4(rays, *child2, t);
+			// Visit the child the packet's first ray enters first, approximates front-to-back for coherent rays
+			if (mask1 && mask2 && packet.DirectionX[0] * (child2->BoundsMin.x - child1->BoundsMin.x)
+				+ packet.DirectionY[0] * (child2->BoundsMin.y - child1->BoundsMin.y)
+				+ packet.DirectionZ[0] * (child2->BoundsMin.z - child1->BoundsMin.z) < 0.0f)
+				std::swap(child1, child2);
+			if (mask1 && mask2)
+			{
+				node = child1;
+				stack[stackPtr++] = child2;
+			}
+			else if (mask1 || mask2)
+				node = mask1 ? child1 : child2;
+			else
+			{
+				if (stackPtr == 0)
+					break;
+				node = stack[--stackPtr];
+			}
+		}
+#else
+		for (int lane = 0; lane < 4; lane++)
+			Intersect(packet.Get(lane), hits.Hits[lane]);
+#endif
+	}
+
+	AABB GetBounds() const
+	{
+		AABB bounds;
+		if (!m_Nodes.empty())
+		{
+			bounds.Min = m_Nodes[0].BoundsMin;
+			bounds.Max = m_Nodes[0].BoundsMax;
+		}
+		return bounds;
+	}
+	unsigned int GetNodeCount() const { return static_cast<unsigned int>(m_Nodes.size()); }
+
+private:
+	struct Triangle
+	{
+		glm::vec3 V0, Edge1, Edge2;
+	};
+	std::vector<BVHNode> m_Nodes;
+	std::vector<Triangle> m_Triangles;          // Leaf order
+	std::vector<unsigned int> m_TriangleIndices; // Leaf order -> original triangle
+
+	// Moller-Trumbore
+	bool IntersectTriangle(const Ray& ray, unsigned int index, RayHit& hit) const
+	{
+		const Triangle& tri = m_Triangles[index];
+		glm::vec3 h = glm::cross(ray.Direction, tri.Edge2);
+		float a = glm::dot(tri.Edge1, h);
+		if (std::fabs(a) < 1e-8f)
+			return false;
+		float f = 1.0f / a;
+		glm::vec3 s = ray.Origin - tri.V0;
+		float u = f * glm::dot(s, h);
+		if (u < 0.0f || u > 1.0f)
+			return false;
+		glm::vec3 q = glm::cross(s, tri.Edge1);
+		float v = f * glm::dot(ray.Direction, q);
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+		float t = f * glm::dot(tri.Edge2, q);
+		if (t <= 1e-5f || t >= hit.t)
+			return false;
+		hit.t = t;
+		hit.u = u;
+		hit.v = v;
+		hit.Triangle = m_TriangleIndices[index];
+		return true;
+	}
+#ifdef BVH_USE_SSE
+	void IntersectTriangle4(const RayPacket4SSE& rays, unsigned int index, float* tMax, RayHit4& hits) const
+	{
+		const Triangle& tri = m_Triangles[index];
+		__m128 e1x = _mm_set1_ps(tri.Edge1.x), e1y = _mm_set1_ps(tri.Edge1.y), e1z = _mm_set1_ps(tri.Edge1.z);
+		__m128 e2x = _mm_set1_ps(tri.Edge2.x), e2y = _mm_set1_ps(tri.Edge2.y), e2z = _mm_set1_ps(tri.Edge2.z);
+
+		__m128 hx = _mm_sub_ps(_mm_mul_ps(rays.DirectionY, e2z), _mm_mul_ps(rays.DirectionZ, e2y));
+		__m128 hy = _mm_sub_ps(_mm_mul_ps(rays.DirectionZ, e2x), _mm_mul_ps(rays.DirectionX, e2z));
+		__m128 hz = _mm_sub_ps(_mm_mul_ps(rays.DirectionX, e2y), _mm_mul_ps(rays.DirectionY, e2x));
+		__m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+		__m128 f = _mm_div_ps(_mm_set1_ps(1.0f), a);
+
+		__m128 sx = _mm_sub_ps(rays.OriginX, _mm_set1_ps(tri.V0.x));
+		__m128 sy = _mm_sub_ps(rays.OriginY, _mm_set1_ps(tri.V0.y));
+		__m128 sz = _mm_sub_ps(rays.OriginZ, _mm_set1_ps(tri.V0.z));
+		__m128 u = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)));
+
+		__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+		__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+		__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+		__m128 v = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(rays.DirectionX, qx), _mm_mul_ps(rays.DirectionY, qy)), _mm_mul_ps(rays.DirectionZ, qz)));
+		__m128 t = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+
+		__m128 zero = _mm_setzero_ps();
+		__m128 absA = _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+		__m128 mask = _mm_cmpge_ps(absA, _mm_set1_ps(1e-8f));
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+		mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+		mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+		mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, _mm_set1_ps(1e-5f)));
+		mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_loadu_ps(tMax)));
+		int bits = _mm_movemask_ps(mask);
+		if (!bits)
+			return;
+
+		float tOut[4], uOut[4], vOut[4];
+		_mm_storeu_ps(tOut, t);
+		_mm_storeu_ps(uOut, u);
+		_mm_storeu_ps(vOut, v);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (!(bits & (1 << lane)))
+				continue;
+			RayHit& hit = hits.Hits[lane];
+			hit.t = tMax[lane] = tOut[lane];
+			hit.u = uOut[lane];
+			hit.v = vOut[lane];
+			hit.Triangle = m_TriangleIndices[index];
+		}
+	}
+#endif
+};
+
+struct BVHInstance
+{
+	const BVH* Blas;
+	glm::mat4 Transform;
+	glm::mat4 InverseTransform;
+	AABB Bounds; // World space
+};
+
+// BVH over mesh instances. Build() once when instances are added, Refit() every frame after moving them
+class TopLevelBVH
+{
+public:
+	unsigned int AddInstance(const BVH& blas, const glm::mat4& transform = glm::mat4(1.0f))
+	{
+		BVHInstance instance;
+		instance.Blas = &blas;
+		m_Instances.push_back(instance);
+		SetTransform(static_cast<unsigned int>(m_Instances.size() - 1), transform);
+		return static_cast<unsigned int>(m_Instances.size() - 1);
+	}
+	void SetTransform(unsigned int index, const glm::mat4& transform)
+	{
+		BVHInstance& instance = m_Instances[index];
+		instance.Transform = transform;
+		instance.InverseTransform = glm::inverse(transform);
+
+		AABB local = instance.Blas->GetBounds();
+		instance.Bounds = AABB();
+		if (local.Min.x > local.Max.x)
+			return;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 point((corner & 1) ? local.Max.x : local.Min.x, (corner & 2) ? local.Max.y : local.Min.y, (corner & 4) ? local.Max.z : local.Min.z);
+			instance.Bounds.Grow(glm::vec3(transform * glm::vec4(point, 1.0f)));
+		}
+	}
+	void Build()
+	{
+		std::vector<AABB> bounds(m_Instances.size());
+		for (size_t i = 0; i < m_Instances.size(); i++)
+			bounds[i] = m_Instances[i].Bounds;
+		BVHBuilder(bounds, m_Nodes, m_InstanceIndices).Build();
+	}
+	void Refit()
+	{
+		// Children are always allocated after their parent, so walking backwards visits them first
+		for (int i = static_cast<int>(m_Nodes.size()) - 1; i >= 0; i--)
+		{
+			if (i == 1)
+				continue;
+			BVHNode& node = m_Nodes[i];
+			AABB bounds;
+			if (node.IsLeaf())
+			{
+				for (unsigned int j = 0; j < node.Count; j++)
+					bounds.Grow(m_Instances[m_InstanceIndices[node.LeftFirst + j]].Bounds);
+			}
+			else
+			{
+				for (unsigned int j = 0; j < 2; j++)
+				{
+					bounds.Grow(m_Nodes[node.LeftFirst + j].BoundsMin);
+					bounds.Grow(m_Nodes[node.LeftFirst + j].BoundsMax);
+				}
+			}
+			node.BoundsMin = bounds.Min;
+			node.BoundsMax = bounds.Max;
+		}
+	}
+
+	bool Intersect(const Ray& ray, RayHit& hit) const
+	{
+		if (m_Nodes.empty())
+			return false;
+		hit.t = std::min(hit.t, ray.TMax);
+		glm::vec3 invDirection = 1.0f / ray.Direction;
+
+		bool found = false;
+		const BVHNode* stack[BVH_STACK_SIZE];
+		unsigned int stackPtr = 0;
+		stack[stackPtr++] = &m_Nodes[0];
+		while (stackPtr > 0)
+		{
+			const BVHNode* node = stack[--stackPtr];
+			if (IntersectAABB(ray, invDirection, *node, hit.t) == FLT_MAX)
+				continue;
+			if (!node->IsLeaf())
+			{
+				stack[stackPtr++] = &m_Nodes[node->LeftFirst + 1];
+				stack[stackPtr++] = &m_Nodes[node->LeftFirst];
+				continue;
+			}
+			for (unsigned int i = 0; i < node->Count; i++)
+			{
+				unsigned int index = m_InstanceIndices[node->LeftFirst + i];
+				const BVHInstance& instance = m_Instances[index];
+				// Direction is left unnormalised so t stays in world units
+				Ray local;
+				local.Origin = glm::vec3(instance.InverseTransform * glm::vec4(ray.Origin, 1.0f));
+				local.Direction = glm::vec3(instance.InverseTransform * glm::vec4(ray.Direction, 0.0f));
+				if (instance.Blas->Intersect(local, hit))
+				{
+					hit.Instance = index;
+					found = true;
+				}
+			}
+		}
+		return found;
+	}
+	void Intersect4(const RayPacket4& packet, RayHit4& hits) const
+	{
+		if (m_Nodes.empty())
+			return;
+#ifdef BVH_USE_SSE
+		RayPacket4SSE rays(packet);
+#else
+		glm::vec3 invDirections[4];
+		for (int lane = 0; lane < 4; lane++)
+			invDirections[lane] = 1.0f / packet.Get(lane).Direction;
+#endif
+		const BVHNode* stack[BVH_STACK_SIZE];
+		unsigned int stackPtr = 0;
+		stack[stackPtr++] = &m_Nodes[0];
+		while (stackPtr > 0)
+		{
+			const BVHNode* node = stack[--stackPtr];
+			float tMax[4];
+			for (int lane = 0; lane < 4; lane++)
+				tMax[lane] = std::min(hits.Hits[lane].t, packet.TMax[lane]);
+#ifdef BVH_USE_SSE
+			bool anyHit = IntersectAABB4(rays, *node, _mm_loadu_ps(tMax)) != 0;
+#else
+			bool anyHit = false;
+			for (int lane = 0; lane < 4 && !anyHit; lane++)
+				anyHit = IntersectAABB(packet.Get(lane), invDirections[lane], *node, tMax[lane]) != FLT_MAX;
+#endif
+			if (!anyHit)
+				continue;
+			if (!node->IsLeaf())
+			{
+				stack[stackPtr++] = &m_Nodes[node->LeftFirst + 1];
+				stack[stackPtr++] = &m_Nodes[node->LeftFirst];
+				continue;
+			}
+			for (unsigned int i = 0; i < node->Count; i++)
+			{
+				unsigned int index = m_InstanceIndices[node->LeftFirst + i];
+				const BVHInstance& instance = m_Instances[index];
+				RayPacket4 local;
+				for (int lane = 0; lane < 4; lane++)
+				{
+					Ray ray = packet.Get(lane);
+					ray.Origin = glm::vec3(instance.InverseTransform * glm::vec4(ray.Origin, 1.0f));
+					ray.Direction = glm::vec3(instance.InverseTransform * glm::vec4(ray.Direction, 0.0f));
+					local.Set(lane, ray);
+					// Closest t before this instance, only lanes it shortens belong to it
+					tMax[lane] = std::min(hits.Hits[lane].t, packet.TMax[lane]);
+				}
+				instance.Blas->Intersect4(local, hits);
+				for (int lane = 0; lane < 4; lane++)
+					if (hits.Hits[lane].t < tMax[lane])
+						hits.Hits[lane].Instance = index;
+			}
+		}
+	}
+
+	unsigned int GetInstanceCount() const { return static_cast<unsigned int>(m_Instances.size()); }
+
+private:
+	std::vector<BVHInstance> m_Instances;
+	std::vector<BVHNode> m_Nodes;
+	std::vector<unsigned int> m_InstanceIndices;
+};
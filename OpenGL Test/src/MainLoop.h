@@ -2,29 +2,40 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <memory>
 
 #include "Shader.h"
 #include "Camera.h"
 #include "Model.h"
+#include "MaterialLibrary.h"
+#include "SceneRenderer.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image/stb_image.h"
 #include "ImGui/imgui_impl_glfw.h"
 #include "ImGui/imgui_impl_opengl3.h"
-#include "GLM/glm.hpp"
-#include "GLM/gtc/matrix_transform.hpp"
-#include "GLM/gtc/type_ptr.hpp"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
 
 // Screen
 const unsigned int screenWidth = 1920;
 const unsigned int screenHeight = 1080;
+int framebufferWidth = screenWidth; // Actual size, tracks window resizes
+int framebufferHeight = screenHeight;
 bool isWireframe = false;
+bool useMaterials = true;
 
 // Camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = screenWidth / 2.0f;
 float lastY = screenHeight / 2.0f;
 bool firstMouse = true;
+bool cursorCaptured = true; // Mouse looks around while captured, C releases it to pick with the cursor
+
+// Picking
+TopLevelBVH* pickScene = nullptr;
+RayHit pickHit;
 
 // Timing
 float deltaTime = 0.0f;
@@ -32,6 +43,8 @@ float lastFrame = 0.0f;
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
+	framebufferWidth = width;
+	framebufferHeight = height;
 	glViewport(0, 0, width, height);
 }
 void mouseCallback(GLFWwindow* window, double xposIn, double yposIn)
@@ -52,7 +65,25 @@ void mouseCallback(GLFWwindow* window, double xposIn, double yposIn)
 	lastX = xpos;
 	lastY = ypos;
 
-	camera.ProcessMouseMovement(xoffset, yoffset);
+	if (cursorCaptured)
+		camera.ProcessMouseMovement(xoffset, yoffset);
+
+	if (pickScene)
+	{
+		// Pick through the centre of the screen while flying around, through the cursor once it's released
+		int windowWidth, windowHeight;
+		glfwGetWindowSize(window, &windowWidth, &windowHeight);
+		float ndcX = cursorCaptured || windowWidth == 0 ? 0.0f : 2.0f * xpos / windowWidth - 1.0f;
+		float ndcY = cursorCaptured || windowHeight == 0 ? 0.0f : 1.0f - 2.0f * ypos / windowHeight;
+		float tanHalfFov = tanf(glm::radians(camera.Zoom) * 0.5f);
+		float aspect = framebufferHeight > 0 ? (float)framebufferWidth / (float)framebufferHeight : 1.0f;
+
+		Ray ray;
+		ray.Origin = camera.Position;
+		ray.Direction = glm::normalize(camera.Front + camera.Right * (ndcX * tanHalfFov * aspect) + camera.Up * (ndcY * tanHalfFov));
+		pickHit = RayHit();
+		pickScene->Intersect(ray, pickHit);
+	}
 }
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 {
@@ -70,6 +101,18 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 		isWireframe = !isWireframe;
 		std::cout << "Wireframe Toggled" << std::endl;
 	}
+	if (key == GLFW_KEY_M && action == GLFW_PRESS)
+	{
+		useMaterials = !useMaterials;
+		std::cout << "Material System Toggled" << std::endl;
+	}
+	if (key == GLFW_KEY_C && action == GLFW_PRESS)
+	{
+		cursorCaptured = !cursorCaptured;
+		glfwSetInputMode(window, GLFW_CURSOR, cursorCaptured ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+		firstMouse = true; // The cursor jumps when the mode changes, don't turn that into a camera move
+		std::cout << "Cursor Toggled" << std::endl;
+	}
 
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
 		camera.ProcessKeyboard(FORWARD, deltaTime);
@@ -100,6 +143,7 @@ public:
 		glFrontFace(GL_CW);
 		//glfwSwapInterval(1); // Enable VSync
 		glewInit();
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
 		// Callbacks
 		glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
@@ -124,6 +168,29 @@ public:
 	{
 		Shader ourShader("res/shader/vertex.glsl", "res/shader/fragment.glsl");
 		Model ourModel("res/model/backpack.obj");
+		ourShader.SetUniformBlockBinding("PerFrame", perFrameBinding);
+
+		// Bindless needs GLSL 4.00, fall back to texture arrays if the driver still won't link it
+		std::unique_ptr<Shader> materialShader;
+		bool bindless = GLEW_ARB_bindless_texture && GLEW_VERSION_4_0;
+		if (bindless)
+		{
+			materialShader.reset(new Shader("res/shader/vertex.glsl", "res/shader/material_bindless_fragment.glsl"));
+			bindless = materialShader->IsLinked();
+		}
+		if (!bindless)
+			materialShader.reset(new Shader("res/shader/vertex.glsl", "res/shader/material_fragment.glsl"));
+		materialShader->SetUniformBlockBinding("PerFrame", perFrameBinding);
+		MaterialLibrary materials(ourModel, bindless);
+		materials.SetupShader(*materialShader, materialsBinding);
+		bool materialsReady = materials.IsComplete() && materialShader->IsLinked(); // Otherwise always use Model::Draw
+
+		TopLevelBVH sceneBVH;
+		for (unsigned int i = 0; i < ourModel.meshes.size(); i++)
+			sceneBVH.AddInstance(ourModel.meshes[i].bvh);
+		sceneBVH.Build();
+		pickScene = &sceneBVH;
+		SceneRenderer renderer(ourModel, sceneBVH, "res/shader", framebufferWidth, framebufferHeight);
 
 		while (!glfwWindowShouldClose(window)) // Main Loop
 		{
@@ -147,29 +214,24 @@ public:
 				m_NumFrames++;
 			
 
-			// Render
-			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glPolygonMode(GL_FRONT_AND_BACK, isWireframe ? GL_LINE : GL_FILL);
-
 			ImGui_ImplOpenGL3_NewFrame();
 			ImGui_ImplGlfw_NewFrame();
 			ImGui::NewFrame();
 
-			ourShader.Bind();
-			glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)screenWidth / (float)screenHeight, 0.1f, 100.0f);
-			glm::mat4 view = camera.GetViewMatrix();
-			ourShader.SetUniformMat4f("projection", projection);
-			ourShader.SetUniformMat4f("view", view);
-
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
-			model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));	// it's a bit too big for our scene, so scale it down
-			ourShader.SetUniformMat4f("model", model);
-			ourModel.Draw(ourShader);
+			bool drawMaterials = useMaterials && materialsReady;
+			renderer.Render(camera, drawMaterials ? *materialShader : ourShader, drawMaterials ? &materials : nullptr, framebufferWidth, framebufferHeight, isWireframe);
 
 			// ImGui Test
 			ImGui::Text("(%.1f FPS)", ImGui::GetIO().Framerate);
+			const ResolutionScaler& resolutionScaler = renderer.GetResolutionScaler();
+			ImGui::Text("Render scale %.0f%% (%dx%d), scene GPU %.2f ms / %.2f ms", resolutionScaler.GetScale() * 100.0f, renderer.GetRenderWidth(), renderer.GetRenderHeight(), resolutionScaler.GetGpuTime(), resolutionScaler.FrameBudget);
+			const RingBufferStats& ringStats = renderer.GetRingStats();
+			ImGui::Text("Uniform ring %s: %u B/frame in %u allocs (peak %u of %u B), %u stalls (%.2f ms), %u overflows", ringStats.Persistent ? "persistent" : "unsynchronised",
+				ringStats.FrameBytes, ringStats.FrameAllocations, ringStats.PeakFrameBytes, ringStats.Capacity, ringStats.Stalls, ringStats.StallTime, ringStats.Overflows);
+			ImGui::Text("Materials %s: %u materials, %s (M to toggle)", drawMaterials ? "on" : "off", materials.GetMaterialCount(),
+				materials.IsBindless() ? "bindless" : (std::to_string(materials.GetArrayCount()) + " texture arrays").c_str());
+			if (pickHit.Hit())
+				ImGui::Text("Picked mesh %u, triangle %u at %.2f (C to %s the cursor)", pickHit.Instance, pickHit.Triangle, pickHit.t, cursorCaptured ? "release" : "capture");
 
 			ImGui::Render();
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -178,6 +240,7 @@ public:
 			glfwSwapBuffers(window);
 			glfwPollEvents();
 		}
+		pickScene = nullptr;
 	}
 private:
 	GLFWwindow* window;
@@ -0,0 +1,327 @@
+#pragma once
+#include <GL/glew.h>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Model.h"
+
+#define MAX_TEXTURE_ARRAYS 4 // Must match material_fragment.glsl
+#define MAX_MATERIALS 256    // Must match both material shaders, 256 * 64 bytes fits the minimum UBO size
+
+// std140 layout of Material in the material shaders. Slots are diffuse, specular, normal, height
+struct MaterialData
+{
+	glm::ivec4 Array;      // Texture array per slot, -1 when the mesh has no texture in that slot
+	glm::ivec4 Layer;      // Layer within that array
+	glm::uvec4 Handles[2]; // Bindless handles as uvec2 pairs, (diffuse, specular) and (normal, height)
+};
+static_assert(sizeof(MaterialData) == 64, "MaterialData must match the std140 layout");
+
+// Draws a whole model without binding textures between meshes.
+// Textures are either copied into one GL_TEXTURE_2D_ARRAY per size and format, or referenced through ARB_bindless_texture
+// handles, and each mesh only sets a material index into a uniform buffer of MaterialData.
+// With ARB_texture_view the model's own textures are replaced by views into the arrays so Model::Draw still works
+// without a second copy. Without it the originals are kept for that fallback, at twice the texture memory.
+class MaterialLibrary
+{
+public:
+	MaterialLibrary(Model& model, bool useBindless)
+		: m_Model(model), m_Bindless(useBindless && GLEW_ARB_bindless_texture), m_Complete(true), m_UBO(0), m_MaterialsBinding(0)
+	{
+		if (m_Bindless)
+			CreateHandles();
+		else
+			CreateArrays();
+		CreateMaterials();
+		ReplaceSourceTextures();
+	}
+	~MaterialLibrary()
+	{
+		for (unsigned int i = 0; i < m_Handles.size(); i++)
+			glMakeTextureHandleNonResidentARB(m_Handles[i]);
+		if (!m_Arrays.empty())
+			glDeleteTextures(static_cast<int>(m_Arrays.size()), m_Arrays.data());
+		glDeleteBuffers(1, &m_UBO);
+	}
+	MaterialLibrary(const MaterialLibrary&) = delete;
+	MaterialLibrary& operator=(const MaterialLibrary&) = delete;
+
+	// Shader must be created from material_fragment.glsl, or material_bindless_fragment.glsl when IsBindless()
+	void SetupShader(Shader& shader, unsigned int materialsBinding)
+	{
+		m_MaterialsBinding = materialsBinding;
+		shader.SetUniformBlockBinding("Materials", materialsBinding);
+		if (m_Bindless)
+			return;
+		shader.Bind();
+		for (int i = 0; i < MAX_TEXTURE_ARRAYS; i++)
+			shader.SetUniform1i("textureArrays[" + std::to_string(i) + "]", i);
+	}
+	void Draw(Shader& shader) const
+	{
+		glBindBufferBase(GL_UNIFORM_BUFFER, m_MaterialsBinding, m_UBO);
+		for (unsigned int i = 0; i < m_Arrays.size(); i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, m_Arrays[i]);
+		}
+		glActiveTexture(GL_TEXTURE0);
+
+		int currentMaterial = -1;
+		for (unsigned int i = 0; i < m_Model.meshes.size(); i++)
+		{
+			Mesh& mesh = m_Model.meshes[i];
+			if (mesh.materialIndex != currentMaterial)
+			{
+				currentMaterial = mesh.materialIndex;
+				shader.SetUniform1i("materialIndex", currentMaterial);
+			}
+			mesh.DrawGeometry();
+		}
+	}
+
+	bool IsBindless() const { return m_Bindless; }
+	bool IsComplete() const { return m_Complete; } // False if some textures or materials didn't fit, use Model::Draw then
+	unsigned int GetMaterialCount() const { return static_cast<unsigned int>(m_Materials.size()); }
+	unsigned int GetArrayCount() const { return static_cast<unsigned int>(m_Arrays.size()); }
+
+private:
+	struct TextureSlot
+	{
+		int Array = -1;
+		int Layer = -1;
+		GLuint64 Handle = 0;
+	};
+	Model& m_Model;
+	bool m_Bindless;
+	bool m_Complete;
+	unsigned int m_UBO;
+	unsigned int m_MaterialsBinding;
+	std::vector<unsigned int> m_Arrays;
+	std::vector<GLuint64> m_Handles;
+	std::map<unsigned int, TextureSlot> m_Slots; // Keyed by GL texture id
+	std::map<unsigned int, unsigned int> m_Views; // Original texture id -> view of its array layer
+	std::vector<MaterialData> m_Materials;
+
+	void CreateHandles()
+	{
+		for (unsigned int i = 0; i < m_Model.textures_loaded.size(); i++)
+		{
+			unsigned int id = m_Model.textures_loaded[i].id;
+			GLuint64 handle = glGetTextureHandleARB(id);
+			glMakeTextureHandleResidentARB(handle);
+			m_Handles.push_back(handle);
+			m_Slots[id].Handle = handle;
+		}
+	}
+	void CreateArrays()
+	{
+		// Group textures by size and format, every group becomes one array in that format
+		std::map<std::tuple<int, int, GLenum>, std::vector<unsigned int>> groups;
+		for (unsigned int i = 0; i < m_Model.textures_loaded.size(); i++)
+		{
+			unsigned int id = m_Model.textures_loaded[i].id;
+			int width = 0, height = 0, internalFormat = 0;
+			glBindTexture(GL_TEXTURE_2D, id);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+			if (width > 0 && height > 0)
+				groups[std::make_tuple(width, height, ArrayFormat(internalFormat))].push_back(id);
+		}
+
+		// Views need immutable storage
+		bool useViews = GLEW_ARB_texture_view && GLEW_ARB_texture_storage;
+		int maxLayers = 0;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+		std::vector<unsigned char> pixels;
+		for (auto it = groups.begin(); it != groups.end(); ++it)
+		{
+			const std::vector<unsigned int>& ids = it->second;
+			if (m_Arrays.size() == MAX_TEXTURE_ARRAYS || static_cast<int>(ids.size()) > maxLayers)
+			{
+				std::cout << "Warning: textures don't fit in " << MAX_TEXTURE_ARRAYS << " texture arrays" << std::endl;
+				m_Complete = false;
+				continue;
+			}
+			int width = std::get<0>(it->first), height = std::get<1>(it->first);
+			GLenum internalFormat = std::get<2>(it->first);
+			GLenum format = PixelFormat(internalFormat);
+			int levels = 1;
+			while ((std::max(width, height) >> levels) > 0)
+				levels++;
+
+			int arrayIndex = static_cast<int>(m_Arrays.size());
+			unsigned int arrayID;
+			glGenTextures(1, &arrayID);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, arrayID);
+			if (useViews)
+				glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, static_cast<int>(ids.size()));
+			else
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormat, width, height, static_cast<int>(ids.size()), 0, format, GL_UNSIGNED_BYTE, nullptr);
+
+			// Read back through the existing textures rather than decoding the files again
+			pixels.resize(static_cast<size_t>(width) * height * ComponentCount(format));
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			for (unsigned int layer = 0; layer < ids.size(); layer++)
+			{
+				glBindTexture(GL_TEXTURE_2D, ids[layer]);
+				glGetTexImage(GL_TEXTURE_2D, 0, format, GL_UNSIGNED_BYTE, pixels.data());
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, format, GL_UNSIGNED_BYTE, pixels.data());
+				m_Slots[ids[layer]].Array = arrayIndex;
+				m_Slots[ids[layer]].Layer = static_cast<int>(layer);
+			}
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+			SetSamplerParameters(GL_TEXTURE_2D_ARRAY);
+			m_Arrays.push_back(arrayID);
+
+			if (!useViews)
+				continue;
+			for (unsigned int layer = 0; layer < ids.size(); layer++)
+			{
+				unsigned int view;
+				glGenTextures(1, &view);
+				glTextureView(view, GL_TEXTURE_2D, arrayID, internalFormat, 0, levels, layer, 1);
+				glBindTexture(GL_TEXTURE_2D, view);
+				SetSamplerParameters(GL_TEXTURE_2D);
+				m_Views[ids[layer]] = view;
+			}
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+	// Hands the views to the model and frees the originals. Views keep the array storage alive, so the model
+	// can outlive this library
+	void ReplaceSourceTextures()
+	{
+		if (m_Views.empty())
+			return;
+		for (unsigned int i = 0; i < m_Model.meshes.size(); i++)
+		{
+			std::vector<Texture>& textures = m_Model.meshes[i].textures;
+			for (unsigned int j = 0; j < textures.size(); j++)
+			{
+				auto view = m_Views.find(textures[j].id);
+				if (view != m_Views.end())
+					textures[j].id = view->second;
+			}
+		}
+		for (unsigned int i = 0; i < m_Model.textures_loaded.size(); i++)
+		{
+			unsigned int& id = m_Model.textures_loaded[i].id;
+			auto view = m_Views.find(id);
+			if (view == m_Views.end())
+				continue;
+			glDeleteTextures(1, &id);
+			id = view->second;
+		}
+	}
+	void CreateMaterials()
+	{
+		// Meshes with the same textures share a material
+		std::map<std::vector<unsigned int>, int> lookup;
+		for (unsigned int i = 0; i < m_Model.meshes.size(); i++)
+		{
+			Mesh& mesh = m_Model.meshes[i];
+			std::vector<unsigned int> key(4, 0);
+			for (unsigned int j = 0; j < mesh.textures.size(); j++)
+			{
+				int slot = SlotIndex(mesh.textures[j].type);
+				if (slot >= 0 && key[slot] == 0)
+					key[slot] = mesh.textures[j].id;
+			}
+
+			auto found = lookup.find(key);
+			if (found != lookup.end())
+			{
+				mesh.materialIndex = found->second;
+				continue;
+			}
+			if (m_Materials.size() == MAX_MATERIALS)
+			{
+				std::cout << "Warning: more than " << MAX_MATERIALS << " materials" << std::endl;
+				m_Complete = false;
+				mesh.materialIndex = 0;
+				continue;
+			}
+
+			MaterialData material{};
+			glm::uvec2 handles[4];
+			for (int slot = 0; slot < 4; slot++)
+			{
+				TextureSlot texture;
+				auto it = m_Slots.find(key[slot]);
+				if (key[slot] != 0 && it != m_Slots.end())
+					texture = it->second;
+				material.Array[slot] = texture.Array;
+				material.Layer[slot] = texture.Layer;
+				handles[slot] = glm::uvec2(static_cast<unsigned int>(texture.Handle), static_cast<unsigned int>(texture.Handle >> 32));
+			}
+			material.Handles[0] = glm::uvec4(handles[0], handles[1]);
+			material.Handles[1] = glm::uvec4(handles[2], handles[3]);
+
+			mesh.materialIndex = static_cast<int>(m_Materials.size());
+			lookup[key] = mesh.materialIndex;
+			m_Materials.push_back(material);
+		}
+
+		glGenBuffers(1, &m_UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+		glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(MaterialData), nullptr, GL_STATIC_DRAW);
+		if (!m_Materials.empty())
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, m_Materials.size() * sizeof(MaterialData), m_Materials.data());
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+	static void SetSamplerParameters(GLenum target)
+	{
+		// Same as TextureFromFile
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	// TextureFromFile creates GL_RED, GL_RGB or GL_RGBA textures, anything else is converted to RGBA8 on readback
+	static GLenum ArrayFormat(int internalFormat)
+	{
+		if (internalFormat == GL_RED || internalFormat == GL_R8)
+			return GL_R8;
+		if (internalFormat == GL_RGB || internalFormat == GL_RGB8)
+			return GL_RGB8;
+		return GL_RGBA8;
+	}
+	static GLenum PixelFormat(GLenum arrayFormat)
+	{
+		if (arrayFormat == GL_R8)
+			return GL_RED;
+		if (arrayFormat == GL_RGB8)
+			return GL_RGB;
+		return GL_RGBA;
+	}
+	static int ComponentCount(GLenum pixelFormat)
+	{
+		if (pixelFormat == GL_RED)
+			return 1;
+		if (pixelFormat == GL_RGB)
+			return 3;
+		return 4;
+	}
+	static int SlotIndex(const std::string& type)
+	{
+		if (type == "texture_diffuse")
+			return 0;
+		if (type == "texture_specular")
+			return 1;
+		if (type == "texture_normal")
+			return 2;
+		if (type == "texture_height")
+			return 3;
+		return -1;
+	}
+};
@@ -7,6 +7,7 @@
 #include "glm/gtc/matrix_transform.hpp"
 
 #include "Shader.h"
+#include "BVH.h"
 
 #define MAX_BONE_INFLUENCE 4
 
@@ -33,6 +34,8 @@ public:
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
 	unsigned int VAO;
+	BVH bvh;
+	int materialIndex = -1; // Set by MaterialLibrary
 
 	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
 	{
@@ -63,10 +66,18 @@ public:
 			shader.SetUniform1i((name + number).c_str(), i);
 			glBindTexture(GL_TEXTURE_2D, textures[i].id);
 		}
+		DrawGeometry();
+		glActiveTexture(GL_TEXTURE0);
+	}
+	void DrawGeometry() const
+	{
 		glBindVertexArray(VAO);
 		glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()),GL_UNSIGNED_INT, 0);
 		glBindVertexArray(0);
-		glActiveTexture(GL_TEXTURE0);
+	}
+	void BuildBVH(bool parallel = true)
+	{
+		bvh.Build(vertices, indices, parallel);
 	}
 
 private:
@@ -1,5 +1,8 @@
 #pragma once
+#include <cstring>
 #include <fstream>
+#include <atomic>
+#include <thread>
 #include <sstream>
 #include <iostream>
 
@@ -10,6 +13,8 @@
 
 #include <Mesh.h>
 
+const unsigned int modelImportFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
 unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma = false)
 {
 	std::string filename(path);
@@ -50,6 +55,63 @@ unsigned int TextureFromFile(const char* path, const std::string& directory, boo
 	return textureID;
 }
 
+// Converts Assimp's vertex streams and faces into our interleaved Vertex layout
+void ConvertMesh(const aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	vertices.reserve(vertices.size() + mesh->mNumVertices);
+	indices.reserve(indices.size() + mesh->mNumFaces * 3);
+
+	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	{
+		Vertex vertex{};
+		glm::vec3 vector{};
+
+		vector.x = mesh->mVertices[i].x;
+		vector.y = mesh->mVertices[i].y;
+		vector.z = mesh->mVertices[i].z;
+		vertex.Position = vector;
+
+		if (mesh->HasNormals())
+		{
+			vector.x = mesh->mNormals[i].x;
+			vector.y = mesh->mNormals[i].y;
+			vector.z = mesh->mNormals[i].z;
+			vertex.Normal = vector;
+		}
+
+		if (mesh->mTextureCoords[0])
+		{
+			glm::vec2 vec{};
+
+			vec.x = mesh->mTextureCoords[0][i].x;
+			vec.y = mesh->mTextureCoords[0][i].y;
+			vertex.TexCoords = vec;
+
+			vector.x = mesh->mTangents[i].x;
+			vector.y = mesh->mTangents[i].y;
+			vector.z = mesh->mTangents[i].z;
+			vertex.Tangent = vector;
+
+			vector.x = mesh->mBitangents[i].x;
+			vector.y = mesh->mBitangents[i].y;
+			vector.z = mesh->mBitangents[i].z;
+			vertex.Bitangent = vector;
+		}
+		else
+			vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+
+		vertices.push_back(vertex);
+	}
+
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+	{
+		const aiFace& face = mesh->mFaces[i];
+
+		for (unsigned int j = 0; j < face.mNumIndices; j++)
+			indices.push_back(face.mIndices[j]);
+	}
+}
+
 class Model
 {
 public:
@@ -73,7 +135,7 @@ private:
 	void loadModel(std::string const& path)
 	{
 		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+		const aiScene* scene = importer.ReadFile(path, modelImportFlags);
 		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 		{
 			std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
@@ -81,6 +143,43 @@ private:
 		}
 		directory = path.substr(0, path.find_last_of('/'));
 		processNode(scene->mRootNode, scene);
+
+		buildBVHs();
+	}
+	void buildBVHs()
+	{
+		// A mesh with most of the triangles gets every core to itself, its builder splits subtrees across threads
+		size_t totalTriangles = 0, largestTriangles = 0;
+		unsigned int largest = 0;
+		for (unsigned int i = 0; i < meshes.size(); i++)
+		{
+			size_t triangles = meshes[i].indices.size() / 3;
+			totalTriangles += triangles;
+			if (triangles > largestTriangles)
+			{
+				largestTriangles = triangles;
+				largest = i;
+			}
+		}
+		bool buildLargestAlone = !meshes.empty() && largestTriangles * 2 > totalTriangles;
+		if (buildLargestAlone)
+			meshes[largest].BuildBVH(true);
+
+		// The rest are built one mesh per worker, BVHs only touch CPU side data
+		std::atomic<unsigned int> next(0);
+		auto worker = [&]()
+		{
+			for (unsigned int i = next++; i < meshes.size(); i = next++)
+				if (!buildLargestAlone || i != largest)
+					meshes[i].BuildBVH(false);
+		};
+		unsigned int threadCount = std::min(std::max(1u, std::thread::hardware_concurrency()), static_cast<unsigned int>(meshes.size()));
+		std::vector<std::thread> workers;
+		for (unsigned int i = 1; i < threadCount; i++)
+			workers.emplace_back(worker);
+		worker();
+		for (unsigned int i = 0; i < workers.size(); i++)
+			workers[i].join();
 	}
 	void processNode(aiNode* node, const aiScene* scene)
 	{
@@ -100,55 +199,7 @@ private:
 		std::vector<unsigned int> indices;
 		std::vector<Texture> textures;
 
-		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
-		{
-			Vertex vertex{};
-			glm::vec3 vector{};
-
-			vector.x = mesh->mVertices[i].x;
-			vector.y = mesh->mVertices[i].y;
-			vector.z = mesh->mVertices[i].z;
-			vertex.Position = vector;
-
-			if (mesh->HasNormals())
-			{
-				vector.x = mesh->mNormals[i].x;
-				vector.y = mesh->mNormals[i].y;
-				vector.z = mesh->mNormals[i].z;
-				vertex.Normal = vector;
-			}
-
-			if (mesh->mTextureCoords[0])
-			{
-				glm::vec2 vec{};
-
-				vec.x = mesh->mTextureCoords[0][i].x;
-				vec.y = mesh->mTextureCoords[0][i].y;
-				vertex.TexCoords = vec;
-
-				vector.x = mesh->mTangents[i].x;
-				vector.y = mesh->mTangents[i].y;
-				vector.z = mesh->mTangents[i].z;
-				vertex.Tangent = vector;
-
-				vector.x = mesh->mBitangents[i].x;
-				vector.y = mesh->mBitangents[i].y;
-				vector.z = mesh->mBitangents[i].z;
-				vertex.Bitangent = vector;
-			}
-			else
-				vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-			vertices.push_back(vertex);
-		}
-
-		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
-		{
-			aiFace face = mesh->mFaces[i];
-
-			for (unsigned int j = 0; j < face.mNumIndices; j++)
-				indices.push_back(face.mIndices[j]);
-		}
+		ConvertMesh(mesh, vertices, indices);
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 		std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
 		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
@@ -0,0 +1,90 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <iostream>
+
+// Offscreen colour + depth target the scene is rendered into before being upscaled to the window.
+// The attachments are sized to the full framebuffer, the scene only renders into a sub-rect of it,
+// so changing the resolution scale every frame never reallocates anything.
+class RenderTarget
+{
+public:
+	RenderTarget(int width, int height)
+		: m_FBO(0), m_ColorTexture(0), m_DepthRBO(0), m_Width(0), m_Height(0)
+	{
+		Resize(width, height);
+	}
+	~RenderTarget()
+	{
+		Release();
+	}
+	RenderTarget(const RenderTarget&) = delete;
+	RenderTarget& operator=(const RenderTarget&) = delete;
+
+	void Resize(int width, int height)
+	{
+		width = std::max(width, 1); // Minimised windows report a 0x0 framebuffer
+		height = std::max(height, 1);
+		if (width == m_Width && height == m_Height)
+			return;
+		Release();
+		m_Width = width;
+		m_Height = height;
+
+		glGenTextures(1, &m_ColorTexture);
+		glBindTexture(GL_TEXTURE_2D, m_ColorTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_Width, m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenRenderbuffers(1, &m_DepthRBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_DepthRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_Width, m_Height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &m_FBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_ColorTexture, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_DepthRBO);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "Error: render target framebuffer is incomplete!" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	void Bind() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+	}
+	void Unbind() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	void BindColorTexture(unsigned int slot = 0) const
+	{
+		glActiveTexture(GL_TEXTURE0 + slot);
+		glBindTexture(GL_TEXTURE_2D, m_ColorTexture);
+	}
+
+	int GetWidth() const { return m_Width; }
+	int GetHeight() const { return m_Height; }
+
+private:
+	unsigned int m_FBO;
+	unsigned int m_ColorTexture;
+	unsigned int m_DepthRBO;
+	int m_Width, m_Height;
+
+	void Release()
+	{
+		if (m_FBO)
+			glDeleteFramebuffers(1, &m_FBO);
+		if (m_ColorTexture)
+			glDeleteTextures(1, &m_ColorTexture);
+		if (m_DepthRBO)
+			glDeleteRenderbuffers(1, &m_DepthRBO);
+		m_FBO = m_ColorTexture = m_DepthRBO = 0;
+		m_Width = m_Height = 0;
+	}
+};
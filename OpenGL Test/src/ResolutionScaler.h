@@ -0,0 +1,114 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+
+const float frameBudgetDefault = 14.0f; // GPU milliseconds for the scene pass, leaves headroom under 60Hz
+const float minScaleDefault = 0.5f;
+const float maxScaleDefault = 1.0f;
+const float sharpnessDefault = 0.3f;
+
+// Picks the scene resolution scale each frame so the GPU time of the scene pass stays under FrameBudget.
+// Timing comes from GL_TIME_ELAPSED queries read back a few frames late, so the CPU never waits on the GPU.
+class ResolutionScaler
+{
+public:
+	float FrameBudget;
+	float MinScale;
+	float MaxScale;
+	float Sharpness;
+	bool Enabled;
+
+	ResolutionScaler(float frameBudget = frameBudgetDefault, float minScale = minScaleDefault, float maxScale = maxScaleDefault)
+		: FrameBudget(frameBudget), MinScale(minScale), MaxScale(maxScale), Sharpness(sharpnessDefault), Enabled(true),
+		m_Scale(maxScale), m_GpuTime(0.0f), m_PixelCost(0.0f), m_Index(0), m_Timing(false)
+	{
+		glGenQueries(queryCount, m_Queries);
+		std::fill(m_Pending, m_Pending + queryCount, false);
+	}
+	~ResolutionScaler()
+	{
+		glDeleteQueries(queryCount, m_Queries);
+	}
+	ResolutionScaler(const ResolutionScaler&) = delete;
+	ResolutionScaler& operator=(const ResolutionScaler&) = delete;
+
+	void BeginFrame()
+	{
+		// The frame has already been sized with the current scale, Collect may change it
+		float frameScale = GetScale();
+		Collect();
+		// Every query is still in flight, skip timing this frame rather than stall on the oldest one
+		m_Timing = !m_Pending[m_Index];
+		if (m_Timing)
+		{
+			glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_Index]);
+			m_QueryScale[m_Index] = frameScale;
+		}
+	}
+	void EndFrame()
+	{
+		if (!m_Timing)
+			return;
+		glEndQuery(GL_TIME_ELAPSED);
+		m_Pending[m_Index] = true;
+		m_Index = (m_Index + 1) % queryCount;
+		m_Timing = false;
+	}
+
+	float GetScale() const { return Enabled ? m_Scale : 1.0f; }
+	float GetGpuTime() const { return m_GpuTime; }
+	int ScaledSize(int size) const
+	{
+		return std::max(1, static_cast<int>(size * GetScale() + 0.5f));
+	}
+
+private:
+	static const int queryCount = 3; // Enough for the driver to run a couple of frames ahead
+	unsigned int m_Queries[queryCount];
+	bool m_Pending[queryCount];
+	float m_QueryScale[queryCount]; // Scale the timed frame was rendered at
+	float m_Scale;
+	float m_GpuTime;
+	float m_PixelCost; // Smoothed GPU time at scale 1, independent of the scale the samples were taken at
+	int m_Index;
+	bool m_Timing;
+
+	void Collect()
+	{
+		// Results arrive in submission order, starting from the oldest slot
+		for (int i = 0; i < queryCount; i++)
+		{
+			int slot = (m_Index + i) % queryCount;
+			if (!m_Pending[slot])
+				continue;
+			int available = 0;
+			glGetQueryObjectiv(m_Queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(m_Queries[slot], GL_QUERY_RESULT, &elapsed);
+			m_Pending[slot] = false;
+			Update(static_cast<float>(elapsed) / 1000000.0f, m_QueryScale[slot]);
+		}
+	}
+	void Update(float gpuTime, float scale)
+	{
+		m_GpuTime = m_GpuTime == 0.0f ? gpuTime : m_GpuTime + (gpuTime - m_GpuTime) * 0.2f;
+
+		// Scene cost scales with pixel count, i.e. with the square of the scale. Samples arrive a few frames late,
+		// so each one is normalised by its own scale rather than compared against the current one
+		float cost = gpuTime / (scale * scale);
+		m_PixelCost = m_PixelCost == 0.0f ? cost : m_PixelCost + (cost - m_PixelCost) * 0.2f;
+		if (!Enabled || m_PixelCost <= 0.0f)
+			return;
+
+		float target = std::sqrt(FrameBudget / m_PixelCost);
+		target = std::min(std::max(target, MinScale), MaxScale);
+
+		// Drop quickly when over budget, creep back up slowly, ignore small changes to avoid shimmering
+		float rate = target < m_Scale ? 0.5f : 0.05f;
+		if (std::fabs(target - m_Scale) > 0.02f)
+			m_Scale += (target - m_Scale) * rate;
+	}
+};
@@ -0,0 +1,202 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+struct RingAllocation
+{
+	unsigned int Buffer = 0;
+	unsigned int Offset = 0;
+	unsigned int Size = 0;
+
+	bool Valid() const { return Size > 0; }
+};
+
+struct RingBufferStats
+{
+	unsigned int Capacity = 0;        // Bytes per frame segment
+	unsigned int FrameBytes = 0;      // Bytes handed out so far this frame
+	unsigned int PeakFrameBytes = 0;
+	unsigned int FrameAllocations = 0;
+	unsigned int Stalls = 0;          // Frames that had to wait on the GPU before reusing a segment
+	unsigned int Overflows = 0;       // Allocations that didn't fit the segment and went to a spare buffer
+	double StallTime = 0.0;           // Total milliseconds spent waiting
+	bool Persistent = false;
+};
+
+// Per-frame linear allocator over one GL buffer split into frameCount segments.
+// Each frame writes into its own segment, a fence placed at EndFrame() guards it until the GPU is done with it.
+// Uses a persistently mapped buffer when ARB_buffer_storage is available, otherwise unsynchronised
+// glMapBufferRange writes, which are safe for the same reason.
+// Uploads go through GL_COPY_WRITE_BUFFER, so using it for GL_ELEMENT_ARRAY_BUFFER data never touches the bound VAO.
+class RingBuffer
+{
+public:
+	RingBuffer(GLenum target, unsigned int frameSize, unsigned int frameCount = 3)
+		: m_Target(target), m_ID(0), m_Mapped(nullptr), m_Frame(0), m_Head(0), m_Alignment(16), m_Fences(frameCount, nullptr),
+		m_Spares(frameCount), m_SparesUsed(0), m_OverflowReported(false)
+	{
+		if (target == GL_UNIFORM_BUFFER)
+		{
+			int alignment = 0;
+			glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+			m_Alignment = std::max(m_Alignment, static_cast<unsigned int>(alignment));
+		}
+		m_Stats.Capacity = frameSize = AlignUp(frameSize);
+		unsigned int totalSize = frameSize * frameCount;
+
+		glGenBuffers(1, &m_ID);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_ID);
+		if (GLEW_ARB_buffer_storage)
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags);
+			m_Mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags));
+			m_Stats.Persistent = m_Mapped != nullptr;
+			if (!m_Mapped)
+				std::cout << "Warning: failed to persistently map ring buffer" << std::endl;
+		}
+		else
+			glBufferData(GL_COPY_WRITE_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	~RingBuffer()
+	{
+		for (unsigned int i = 0; i < m_Fences.size(); i++)
+			if (m_Fences[i])
+				glDeleteSync(m_Fences[i]);
+		if (m_Mapped)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, m_ID);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &m_ID);
+		for (unsigned int i = 0; i < m_Spares.size(); i++)
+			if (!m_Spares[i].empty())
+				glDeleteBuffers(static_cast<int>(m_Spares[i].size()), m_Spares[i].data());
+	}
+	RingBuffer(const RingBuffer&) = delete;
+	RingBuffer& operator=(const RingBuffer&) = delete;
+
+	void BeginFrame()
+	{
+		GLsync& fence = m_Fences[m_Frame];
+		if (fence)
+		{
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				m_Stats.Stalls++;
+				double start = glfwGetTime();
+				while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+				m_Stats.StallTime += (glfwGetTime() - start) * 1000.0;
+			}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+		m_Head = 0;
+		m_SparesUsed = 0;
+		m_Stats.FrameBytes = 0;
+		m_Stats.FrameAllocations = 0;
+	}
+	void EndFrame()
+	{
+		m_Fences[m_Frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_Frame = (m_Frame + 1) % static_cast<unsigned int>(m_Fences.size());
+	}
+
+	// Copies size bytes into this frame's segment. If the segment is full the data goes to a spare buffer instead,
+	// slower but never overwrites anything the GPU may still read
+	RingAllocation Allocate(const void* data, unsigned int size)
+	{
+		RingAllocation allocation;
+		unsigned int alignedSize = AlignUp(size);
+		if (m_Head + alignedSize > m_Stats.Capacity)
+			return AllocateSpare(data, size);
+		allocation.Buffer = m_ID;
+		allocation.Offset = m_Frame * m_Stats.Capacity + m_Head;
+		allocation.Size = size;
+		m_Head += alignedSize;
+
+		if (m_Mapped)
+			std::memcpy(m_Mapped + allocation.Offset, data, size);
+		else
+		{
+			// The fence guarantees the GPU is done with this range, so skip the driver's own synchronisation
+			glBindBuffer(GL_COPY_WRITE_BUFFER, m_ID);
+			void* dst = glMapBufferRange(GL_COPY_WRITE_BUFFER, allocation.Offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			if (dst)
+			{
+				std::memcpy(dst, data, size);
+				glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			}
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+
+		m_Stats.FrameBytes = m_Head;
+		m_Stats.FrameAllocations++;
+		m_Stats.PeakFrameBytes = std::max(m_Stats.PeakFrameBytes, m_Head);
+		return allocation;
+	}
+	template<typename T>
+	RingAllocation Allocate(const T& value)
+	{
+		return Allocate(&value, sizeof(T));
+	}
+
+	// Binds an allocation to an indexed target such as a uniform block binding point
+	void BindRange(const RingAllocation& allocation, unsigned int index) const
+	{
+		if (!allocation.Valid())
+			return;
+		glBindBufferRange(m_Target, index, allocation.Buffer, allocation.Offset, allocation.Size);
+	}
+
+	const RingBufferStats& GetStats() const { return m_Stats; }
+
+private:
+	GLenum m_Target;
+	unsigned int m_ID;
+	unsigned char* m_Mapped;
+	unsigned int m_Frame;
+	unsigned int m_Head;
+	unsigned int m_Alignment;
+	std::vector<GLsync> m_Fences;
+	std::vector<std::vector<unsigned int>> m_Spares; // Overflow buffers per frame segment, reused once its fence passes
+	unsigned int m_SparesUsed;
+	bool m_OverflowReported;
+	RingBufferStats m_Stats;
+
+	RingAllocation AllocateSpare(const void* data, unsigned int size)
+	{
+		m_Stats.Overflows++;
+		if (!m_OverflowReported)
+		{
+			std::cout << "Warning: ring buffer frame segment of " << m_Stats.Capacity << " bytes is full, using spare buffers. Increase its frame size" << std::endl;
+			m_OverflowReported = true;
+		}
+
+		std::vector<unsigned int>& spares = m_Spares[m_Frame];
+		if (m_SparesUsed == spares.size())
+		{
+			unsigned int id;
+			glGenBuffers(1, &id);
+			spares.push_back(id);
+		}
+		RingAllocation allocation;
+		allocation.Buffer = spares[m_SparesUsed++];
+		allocation.Size = size;
+		glBindBuffer(GL_COPY_WRITE_BUFFER, allocation.Buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_STREAM_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return allocation;
+	}
+
+	unsigned int AlignUp(unsigned int size) const
+	{
+		return (size + m_Alignment - 1) / m_Alignment * m_Alignment;
+	}
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <GL/glew.h>
+#include <string>
+
+#include "Shader.h"
+#include "Camera.h"
+#include "Model.h"
+#include "BVH.h"
+#include "MaterialLibrary.h"
+#include "RenderTarget.h"
+#include "ResolutionScaler.h"
+#include "RingBuffer.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+// Uniform block binding points
+const unsigned int perFrameBinding = 0;
+const unsigned int materialsBinding = 1;
+
+// Submits one frame of the scene: per-frame uniforms through the ring buffer, the offscreen pass at the scaled resolution,
+// the pick BVH refit and the upscale into the default framebuffer. App::Run and engine_bench both go through this,
+// so the benchmark measures the same work the app does. UI is left to the caller, drawn after Render().
+class SceneRenderer
+{
+public:
+	SceneRenderer(Model& model, TopLevelBVH& sceneBVH, const std::string& shaderDir, int width, int height)
+		: m_Model(model), m_SceneBVH(sceneBVH), m_UniformRing(GL_UNIFORM_BUFFER, 64 * 1024), m_SceneTarget(width, height),
+		m_UpscaleShader((shaderDir + "/upscale_vertex.glsl").c_str(), (shaderDir + "/upscale_fragment.glsl").c_str()),
+		m_EmptyVAO(0), m_RenderWidth(0), m_RenderHeight(0)
+	{
+		glGenVertexArrays(1, &m_EmptyVAO); // Core profile needs a VAO bound even for attribute-less draws
+	}
+	~SceneRenderer()
+	{
+		glDeleteVertexArrays(1, &m_EmptyVAO);
+	}
+	SceneRenderer(const SceneRenderer&) = delete;
+	SceneRenderer& operator=(const SceneRenderer&) = delete;
+
+	// Draws the scene with shader, through materials when given, otherwise Model::Draw.
+	// width and height are the window's framebuffer size
+	void Render(Camera& camera, Shader& shader, const MaterialLibrary* materials, int width, int height, bool wireframe)
+	{
+		m_UniformRing.BeginFrame();
+
+		// Render scene offscreen at the scaled resolution
+		m_SceneTarget.Resize(width, height);
+		m_RenderWidth = m_ResolutionScaler.ScaledSize(m_SceneTarget.GetWidth());
+		m_RenderHeight = m_ResolutionScaler.ScaledSize(m_SceneTarget.GetHeight());
+		m_SceneTarget.Bind();
+		glViewport(0, 0, m_RenderWidth, m_RenderHeight);
+		m_ResolutionScaler.BeginFrame();
+
+		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
+
+		shader.Bind();
+		struct PerFrame
+		{
+			glm::mat4 projection;
+			glm::mat4 view;
+		} perFrame;
+		perFrame.projection = glm::perspective(glm::radians(camera.Zoom), (float)m_SceneTarget.GetWidth() / (float)m_SceneTarget.GetHeight(), 0.1f, 100.0f);
+		perFrame.view = camera.GetViewMatrix();
+		m_UniformRing.BindRange(m_UniformRing.Allocate(perFrame), perFrameBinding);
+
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
+		model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));	// it's a bit too big for our scene, so scale it down
+		shader.SetUniformMat4f("model", model);
+		if (materials)
+			materials->Draw(shader);
+		else
+			m_Model.Draw(shader);
+
+		for (unsigned int i = 0; i < m_SceneBVH.GetInstanceCount(); i++)
+			m_SceneBVH.SetTransform(i, model);
+		m_SceneBVH.Refit();
+
+		m_ResolutionScaler.EndFrame();
+		m_SceneTarget.Unbind();
+
+		// Upscale and sharpen to the window
+		glViewport(0, 0, width, height);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		glDisable(GL_CULL_FACE);
+		m_UpscaleShader.Bind();
+		m_SceneTarget.BindColorTexture(0);
+		m_UpscaleShader.SetUniform1i("screenTexture", 0);
+		m_UpscaleShader.SetUniform2f("uvScale", (float)m_RenderWidth / m_SceneTarget.GetWidth(), (float)m_RenderHeight / m_SceneTarget.GetHeight());
+		m_UpscaleShader.SetUniform2f("texelSize", 1.0f / m_SceneTarget.GetWidth(), 1.0f / m_SceneTarget.GetHeight());
+		m_UpscaleShader.SetUniform1f("sharpness", m_ResolutionScaler.Sharpness);
+		glBindVertexArray(m_EmptyVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindVertexArray(0);
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glEnable(GL_CULL_FACE);
+
+		m_UniformRing.EndFrame();
+	}
+
+	ResolutionScaler& GetResolutionScaler() { return m_ResolutionScaler; }
+	const RingBufferStats& GetRingStats() const { return m_UniformRing.GetStats(); }
+	int GetRenderWidth() const { return m_RenderWidth; } // Scene resolution of the last frame
+	int GetRenderHeight() const { return m_RenderHeight; }
+
+private:
+	Model& m_Model;
+	TopLevelBVH& m_SceneBVH;
+	RingBuffer m_UniformRing;
+	RenderTarget m_SceneTarget;
+	ResolutionScaler m_ResolutionScaler;
+	Shader m_UpscaleShader;
+	unsigned int m_EmptyVAO;
+	int m_RenderWidth, m_RenderHeight;
+};
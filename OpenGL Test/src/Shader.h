@@ -1,6 +1,7 @@
 #pragma once
 #include <GL/glew.h>
 #include <fstream>
+#include <iostream>
 #include <sstream>
 #include <string>
 #include <unordered_map>
@@ -11,7 +12,7 @@ class Shader
 {
 public:
 	Shader(const char* vertexPath, const char* fragmentPath)
-		: m_ID(0), m_vertexPath(vertexPath), m_fragmentPath(fragmentPath)
+		: m_vertexPath(vertexPath), m_fragmentPath(fragmentPath), m_ID(0)
 	{
 		std::string vertexCode, fragmentCode;
 		std::ifstream vShaderFile, fShaderFile;
@@ -43,6 +44,12 @@ public:
 	{
 		glUseProgram(0);
 	}
+	bool IsLinked() const
+	{
+		int status = 0;
+		glGetProgramiv(m_ID, GL_LINK_STATUS, &status);
+		return status == GL_TRUE;
+	}
 
 	void SetUniform1i(const std::string& name, int value)
 	{
@@ -52,6 +59,10 @@ public:
 	{
 		glUniform1f(GetUniformLocation(name), value);
 	}
+	void SetUniform2f(const std::string& name, float v0, float v1)
+	{
+		glUniform2f(GetUniformLocation(name), v0, v1);
+	}
 	void SetUniform3f(const std::string& name, float v0, float v1, float v2)
 	{
 		glUniform3f(GetUniformLocation(name), v0, v1, v2);
@@ -68,6 +79,16 @@ public:
 	{
 		glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &matrix[0][0]);
 	}
+	void SetUniformBlockBinding(const std::string& name, unsigned int binding)
+	{
+		unsigned int index = glGetUniformBlockIndex(m_ID, name.c_str());
+		if (index == GL_INVALID_INDEX)
+		{
+			std::cout << "Warning: uniform block '" << name << "' doesn't exist!" << std::endl;
+			return;
+		}
+		glUniformBlockBinding(m_ID, index, binding);
+	}
 
 private:
 	std::string m_vertexPath;
@@ -95,6 +116,15 @@ private:
 		glLinkProgram(program);
 		glValidateProgram(program);
 
+		int status = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+		if (status != GL_TRUE)
+		{
+			char log[1024] = {};
+			glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+			std::cout << "Error: shader '" << m_vertexPath << "' + '" << m_fragmentPath << "' failed to link!\n" << log << std::endl;
+		}
+
 		glDeleteShader(vs);
 		glDeleteShader(fs);
 